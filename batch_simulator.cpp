@@ -0,0 +1,742 @@
+#include "batch_simulator.h"
+#include "syscall_emulation.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+BatchIDEX::BatchIDEX() : IR(0), PC(0), NPC(0), Imm(0), valid(false)
+{
+    memset(A, 0, sizeof(A));
+    memset(B, 0, sizeof(B));
+}
+
+BatchEXMEM::BatchEXMEM() : IR(0), valid(false)
+{
+    memset(ALUOutput, 0, sizeof(ALUOutput));
+    memset(B, 0, sizeof(B));
+}
+
+BatchMEMWB::BatchMEMWB() : IR(0), valid(false)
+{
+    memset(ALUOutput, 0, sizeof(ALUOutput));
+    memset(LMD, 0, sizeof(LMD));
+}
+
+BatchGroup::BatchGroup()
+    : PC(0), stall(false), squash_if_id(false), branch_taken(false),
+      trapPending(false), fetchLength(4),
+      ifIR(0), ifPC(0), ifNPC(0), ifValid(false)
+{
+    memset(active, 0, sizeof(active));
+    memset(branchPC, 0, sizeof(branchPC));
+    memset(exiting, 0, sizeof(exiting));
+    memset(faulting, 0, sizeof(faulting));
+}
+
+BatchSimulator::BatchSimulator()
+{
+    instructionMemory.resize(512, 0);
+    dataWords = 0;
+    resizeDataMemory(512);
+    entryPC = 0;
+    initialBreak = dataWords * 4;
+    reset();
+}
+
+bool BatchSimulator::loadProgram(const string &filename)
+{
+    RISCVSimulator loader;
+    if (!loader.loadProgram(filename))
+        return false;
+    loader.reset();
+
+    Span<uint32_t> text = loader.getInstructionMemory();
+    Span<int32_t> data = loader.getDataMemory();
+    instructionMemory.assign(text.begin(), text.end());
+    dataWords = 0;
+    dataMemory.clear();
+    resizeDataMemory(data.size());
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        for (int lane = 0; lane < LANES; lane++)
+            dataMemory[i * LANES + lane] = data[i];
+    }
+    entryPC = loader.getPC();
+    initialBreak = data.size() * 4;
+    reset(laneCount);
+    return true;
+}
+
+// Restarts every lane at the entry point. Data memory is left as loaded or
+// set, like RISCVSimulator::reset().
+void BatchSimulator::reset(int lanes)
+{
+    laneCount = max(1, min(lanes, (int)LANES));
+    memset(registers, 0, sizeof(registers));
+    memset(totalCycles, 0, sizeof(totalCycles));
+    memset(if_utilization, 0, sizeof(if_utilization));
+    memset(id_utilization, 0, sizeof(id_utilization));
+    memset(ex_utilization, 0, sizeof(ex_utilization));
+    memset(mem_utilization, 0, sizeof(mem_utilization));
+    memset(wb_utilization, 0, sizeof(wb_utilization));
+    memset(instructionsCompleted, 0, sizeof(instructionsCompleted));
+    memset(exited, 0, sizeof(exited));
+    memset(exitCode, 0, sizeof(exitCode));
+    memset(faulted, 0, sizeof(faulted));
+    for (int lane = 0; lane < LANES; lane++)
+    {
+        programBreak[lane] = initialBreak;
+        output[lane].clear();
+    }
+    groupCycles = laneCycles = 0;
+    splits = merges = 0;
+
+    groups.assign(1, BatchGroup());
+    BatchGroup &group = groups[0];
+    for (int lane = 0; lane < laneCount; lane++)
+        group.active[lane] = 1;
+    group.PC = entryPC;
+    if (isGroupComplete(group))
+        groups.clear();
+}
+
+void BatchSimulator::resizeDataMemory(size_t words)
+{
+    if (words <= dataWords)
+        return;
+    dataMemory.resize(words * LANES, 0);
+    dataWords = words;
+}
+
+void BatchSimulator::setDataMemory(int lane, Span<int32_t> image)
+{
+    resizeDataMemory(image.size());
+    for (size_t i = 0; i < image.size(); i++)
+        dataMemory[i * LANES + lane] = image[i];
+}
+
+void BatchSimulator::setDataWord(int lane, size_t index, int32_t value)
+{
+    resizeDataMemory(index + 1);
+    dataMemory[index * LANES + lane] = value;
+}
+
+void BatchSimulator::setRegister(int lane, int reg, int32_t value)
+{
+    if (reg != 0)
+        registers[reg][lane] = value;
+}
+
+double BatchSimulator::getLockstepEfficiency() const
+{
+    if (groupCycles == 0)
+        return 1.0;
+    return (double)laneCycles / ((double)groupCycles * laneCount);
+}
+
+bool BatchSimulator::fetchable(uint32_t pc) const
+{
+    return readParcel(instructionMemory.data(), instructionMemory.size(), pc) != 0;
+}
+
+bool BatchSimulator::isGroupComplete(const BatchGroup &group) const
+{
+    return !group.ifValid && !group.id_ex.valid && !group.ex_mem.valid &&
+           !group.mem_wb.valid && !fetchable(group.PC);
+}
+
+// Byte-level view of one lane for emulateSyscall(). Lanes have no input, and
+// their output is collected in output[lane].
+class BatchSimulator::LaneGuest
+{
+public:
+    LaneGuest(BatchSimulator &sim, int lane) : sim(sim), lane(lane) {}
+
+    int32_t readRegister(int reg) { return sim.registers[reg][lane]; }
+    void writeRegister(int reg, int32_t value) { sim.setRegister(lane, reg, value); }
+
+    bool loadByte(uint32_t address, uint8_t &value)
+    {
+        if (address / 4 >= sim.dataWords)
+            return false;
+        value = (uint8_t)((uint32_t)sim.getDataWord(lane, address / 4) >> (8 * (address % 4)));
+        return true;
+    }
+
+    bool storeByte(uint32_t address, uint8_t value)
+    {
+        if (address / 4 >= sim.dataWords)
+            return false;
+        uint32_t shift = 8 * (address % 4);
+        int32_t &word = sim.dataMemory[(address / 4) * LANES + lane];
+        word = (int32_t)(((uint32_t)word & ~(0xFFu << shift)) | ((uint32_t)value << shift));
+        return true;
+    }
+
+    uint32_t getBreak() { return sim.programBreak[lane]; }
+
+    bool setBreak(uint32_t address)
+    {
+        if (address > MAX_PROGRAM_BREAK)
+            return false;
+        sim.resizeDataMemory((address + 3) / 4);
+        sim.programBreak[lane] = address;
+        return true;
+    }
+
+    uint64_t getCycles() { return sim.totalCycles[lane]; }
+    void output(int /*fd*/, const char *data, size_t size) { sim.output[lane].append(data, size); }
+    size_t input(char * /*data*/, size_t /*size*/) { return 0; }
+    void exit(int32_t code) { sim.exitCode[lane] = code; }
+
+private:
+    BatchSimulator &sim;
+    int lane;
+};
+
+// Stale latch fields (Imm, ALUOutput, LMD) are kept per lane or compared
+// here, so merged lanes continue exactly as they would have apart.
+bool BatchSimulator::sameControl(const BatchGroup &a, const BatchGroup &b) const
+{
+    return a.PC == b.PC && a.stall == b.stall && a.squash_if_id == b.squash_if_id &&
+           a.trapPending == b.trapPending && a.fetchLength == b.fetchLength &&
+           a.fetchBuffer.start == b.fetchBuffer.start && a.fetchBuffer.end == b.fetchBuffer.end &&
+           a.ifValid == b.ifValid && a.ifIR == b.ifIR && a.ifPC == b.ifPC && a.ifNPC == b.ifNPC &&
+           a.id_ex.valid == b.id_ex.valid && a.id_ex.IR == b.id_ex.IR &&
+           a.id_ex.PC == b.id_ex.PC && a.id_ex.NPC == b.id_ex.NPC && a.id_ex.Imm == b.id_ex.Imm &&
+           a.ex_mem.valid == b.ex_mem.valid && a.ex_mem.IR == b.ex_mem.IR &&
+           a.mem_wb.valid == b.mem_wb.valid && a.mem_wb.IR == b.mem_wb.IR;
+}
+
+// The stages mirror RISCVSimulator's, but update the latches in place: with
+// the WB, MEM, EX, ID, IF order each latch has been consumed before the
+// stage that produces it runs, so the stale fields a _next latch would carry
+// are the ones already in place.
+void BatchSimulator::WB_stage(BatchGroup &group)
+{
+    const BatchMEMWB &mem_wb = group.mem_wb;
+    const int32_t *active = group.active;
+    if (!mem_wb.valid)
+        return;
+
+    uint32_t opcode = RISCVSimulator::getOpcode(mem_wb.IR);
+    uint32_t rd = RISCVSimulator::getRd(mem_wb.IR);
+
+    for (int l = 0; l < LANES; l++)
+        wb_utilization[l] += active[l];
+
+    if (rd != 0)
+    {
+        int32_t *dest = registers[rd];
+        if (opcode == 0x03)
+        { // lw
+            for (int l = 0; l < LANES; l++)
+                dest[l] = active[l] ? mem_wb.LMD[l] : dest[l];
+        }
+        else if (opcode == 0x33 || opcode == 0x13 || opcode == 0x37 ||
+                 opcode == 0x6F || opcode == 0x67)
+        {
+            for (int l = 0; l < LANES; l++)
+                dest[l] = active[l] ? mem_wb.ALUOutput[l] : dest[l];
+
+            if (opcode == 0x33 && RISCVSimulator::getFunct3(mem_wb.IR) == 0x0 &&
+                RISCVSimulator::getFunct7(mem_wb.IR) == 0x01 && rd < 31)
+            {
+                const int32_t *a = registers[RISCVSimulator::getRs1(mem_wb.IR)];
+                const int32_t *b = registers[RISCVSimulator::getRs2(mem_wb.IR)];
+                int32_t *high = registers[rd + 1];
+                for (int l = 0; l < LANES; l++)
+                {
+                    int32_t value = (int32_t)(((int64_t)a[l] * (int64_t)b[l]) >> 32);
+                    high[l] = active[l] ? value : high[l];
+                }
+            }
+        }
+    }
+
+    if (mem_wb.IR == ECALL_INSTRUCTION)
+    {
+        for (int l = 0; l < LANES; l++)
+        {
+            LaneGuest guest(*this, l);
+            if (active[l] && !emulateSyscall(guest))
+                group.exiting[l] = 1;
+        }
+        group.trapPending = false;
+    }
+
+    for (int l = 0; l < LANES; l++)
+    {
+        registers[0][l] = 0;
+        instructionsCompleted[l] += active[l];
+    }
+}
+
+void BatchSimulator::MEM_stage(BatchGroup &group, BatchMEMWB &next)
+{
+    const BatchEXMEM &ex_mem = group.ex_mem;
+    const int32_t *active = group.active;
+    if (!ex_mem.valid)
+    {
+        next = BatchMEMWB();
+        return;
+    }
+
+    if (ex_mem.IR == ILLEGAL_INSTRUCTION)
+    {
+        for (int l = 0; l < LANES; l++)
+            group.faulting[l] = active[l];
+        next = BatchMEMWB();
+        return;
+    }
+
+    uint32_t opcode = RISCVSimulator::getOpcode(ex_mem.IR);
+
+    next.IR = ex_mem.IR;
+    next.valid = true;
+    for (int l = 0; l < LANES; l++)
+    {
+        next.ALUOutput[l] = ex_mem.ALUOutput[l];
+        mem_utilization[l] += active[l];
+    }
+
+    if (opcode == 0x03)
+    {
+        for (int l = 0; l < LANES; l++)
+        {
+            int address = ex_mem.ALUOutput[l] / 4;
+            if (address >= 0 && (size_t)address < dataWords)
+                next.LMD[l] = dataMemory[address * LANES + l];
+        }
+    }
+    else if (opcode == 0x23)
+    {
+        for (int l = 0; l < LANES; l++)
+        {
+            int address = ex_mem.ALUOutput[l] / 4;
+            if (active[l] && address >= 0 && (size_t)address < dataWords)
+                dataMemory[address * LANES + l] = ex_mem.B[l];
+        }
+    }
+}
+
+void BatchSimulator::EX_stage(BatchGroup &group, BatchEXMEM &next)
+{
+    const BatchIDEX &id_ex = group.id_ex;
+    const int32_t *active = group.active;
+    if (!id_ex.valid)
+    {
+        next = BatchEXMEM();
+        return;
+    }
+
+    uint32_t opcode = RISCVSimulator::getOpcode(id_ex.IR);
+    uint32_t funct3 = RISCVSimulator::getFunct3(id_ex.IR);
+    uint32_t funct7 = RISCVSimulator::getFunct7(id_ex.IR);
+    const int32_t *A = id_ex.A;
+    const int32_t *B = id_ex.B;
+    const int32_t imm = id_ex.Imm;
+    int32_t *out = next.ALUOutput;
+
+    next.IR = id_ex.IR;
+    next.valid = true;
+    for (int l = 0; l < LANES; l++)
+    {
+        next.B[l] = B[l];
+        ex_utilization[l] += active[l];
+    }
+
+    if (opcode == 0x33)
+    {
+        if (funct3 == 0x0 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] + B[l];
+        }
+        else if (funct3 == 0x0 && funct7 == 0x20)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] - B[l];
+        }
+        else if (funct3 == 0x0 && funct7 == 0x01)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = (int32_t)(((int64_t)A[l] * (int64_t)B[l]) & 0xFFFFFFFF);
+        }
+        else if (funct3 == 0x4 && funct7 == 0x01)
+        {
+            // Division is only evaluated on owned lanes; other lanes may hold
+            // operands that would trap.
+            for (int l = 0; l < LANES; l++)
+            {
+                if (active[l])
+                    out[l] = (B[l] != 0) ? A[l] / B[l] : -1;
+            }
+        }
+        else if (funct3 == 0x6 && funct7 == 0x01)
+        {
+            for (int l = 0; l < LANES; l++)
+            {
+                if (active[l])
+                    out[l] = (B[l] != 0) ? A[l] % B[l] : A[l];
+            }
+        }
+        else if (funct3 == 0x7 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] & B[l];
+        }
+        else if (funct3 == 0x6 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] | B[l];
+        }
+        else if (funct3 == 0x1 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] << (B[l] & 0x1F);
+        }
+        else if (funct3 == 0x5 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = (uint32_t)A[l] >> (B[l] & 0x1F);
+        }
+        else if (funct3 == 0x2 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = (A[l] < B[l]) ? 1 : 0;
+        }
+        else if (funct3 == 0x3 && funct7 == 0x00)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = ((uint32_t)A[l] < (uint32_t)B[l]) ? 1 : 0;
+        }
+    }
+    else if (opcode == 0x13)
+    {
+        if (funct3 == 0x0)
+        {
+            int32_t sign = ((id_ex.IR >> 30) & 0x1) ? -1 : 1;
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] + sign * imm;
+        }
+        else if (funct3 == 0x7)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] & imm;
+        }
+        else if (funct3 == 0x6)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] | imm;
+        }
+        else if (funct3 == 0x1)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = A[l] << (imm & 0x1F);
+        }
+        else if (funct3 == 0x5)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = (uint32_t)A[l] >> (imm & 0x1F);
+        }
+        else if (funct3 == 0x2)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = (A[l] < imm) ? 1 : 0;
+        }
+        else if (funct3 == 0x3)
+        {
+            for (int l = 0; l < LANES; l++)
+                out[l] = ((uint32_t)A[l] < (uint32_t)imm) ? 1 : 0;
+        }
+    }
+    else if (opcode == 0x03 || opcode == 0x23)
+    {
+        for (int l = 0; l < LANES; l++)
+            out[l] = A[l] + imm;
+    }
+    else if (opcode == 0x63)
+    {
+        uint32_t target = id_ex.PC + imm;
+        bool isBeq = (funct3 == 0x0);
+        for (int l = 0; l < LANES; l++)
+            group.branchPC[l] = (isBeq && A[l] == B[l]) ? target : id_ex.NPC;
+        group.branch_taken = true;
+        group.squash_if_id = true;
+    }
+    else if (opcode == 0x37)
+    {
+        for (int l = 0; l < LANES; l++)
+            out[l] = imm;
+    }
+    else if (opcode == 0x6F)
+    {
+        for (int l = 0; l < LANES; l++)
+        {
+            out[l] = id_ex.NPC;
+            group.branchPC[l] = id_ex.PC + imm;
+        }
+        group.branch_taken = true;
+        group.squash_if_id = true;
+    }
+    else if (opcode == 0x67)
+    { // jalr
+        for (int l = 0; l < LANES; l++)
+        {
+            out[l] = id_ex.NPC;
+            group.branchPC[l] = (A[l] + imm) & ~1;
+        }
+        group.branch_taken = true;
+        group.squash_if_id = true;
+    }
+}
+
+void BatchSimulator::ID_stage(BatchGroup &group, BatchIDEX &next)
+{
+    const int32_t *active = group.active;
+    if (group.squash_if_id)
+    {
+        next = BatchIDEX();
+        group.squash_if_id = false;
+        return;
+    }
+
+    if (!group.ifValid)
+    {
+        next = BatchIDEX();
+        return;
+    }
+
+    uint32_t ir = group.ifIR;
+    uint32_t opcode = RISCVSimulator::getOpcode(ir);
+
+    // EX and MEM have already advanced, so the producers the scalar core
+    // checks in id_ex and ex_mem now sit in ex_mem and mem_wb.
+    bool hazard = (group.ex_mem.valid && RISCVSimulator::dependsOn(ir, group.ex_mem.IR)) ||
+                  (group.mem_wb.valid && RISCVSimulator::dependsOn(ir, group.mem_wb.IR));
+    if (hazard && opcode != 0x63 && opcode != 0x6F && opcode != 0x67)
+    {
+        next = BatchIDEX();
+        group.stall = true;
+        return;
+    }
+
+    const int32_t *rs1 = registers[RISCVSimulator::getRs1(ir)];
+    const int32_t *rs2 = registers[RISCVSimulator::getRs2(ir)];
+    next.IR = ir;
+    next.PC = group.ifPC;
+    next.NPC = group.ifNPC;
+    next.valid = true;
+    for (int l = 0; l < LANES; l++)
+    {
+        next.A[l] = rs1[l];
+        next.B[l] = rs2[l];
+        id_utilization[l] += active[l];
+    }
+
+    if (opcode == 0x13 || opcode == 0x03 || opcode == 0x67)
+        next.Imm = RISCVSimulator::getImmI(ir);
+    else if (opcode == 0x23)
+        next.Imm = RISCVSimulator::getImmS(ir);
+    else if (opcode == 0x63)
+        next.Imm = RISCVSimulator::getImmB(ir);
+    else if (opcode == 0x37)
+        next.Imm = RISCVSimulator::getImmU(ir);
+    else if (opcode == 0x6F)
+        next.Imm = RISCVSimulator::getImmJ(ir);
+
+    if (ir == ECALL_INSTRUCTION)
+        group.trapPending = true;
+}
+
+void BatchSimulator::cycleGroup(BatchGroup &group)
+{
+    const int32_t *active = group.active;
+    bool was_stalled = group.stall;
+    group.stall = false;
+    group.branch_taken = false;
+
+    WB_stage(group);
+    MEM_stage(group, group.mem_wb);
+    EX_stage(group, group.ex_mem);
+    ID_stage(group, group.id_ex);
+
+    if (group.branch_taken || group.trapPending)
+    {
+        if (!group.stall)
+        {
+            group.ifValid = false;
+            group.ifIR = 0;
+            group.ifPC = 0;
+            group.ifNPC = 0;
+        }
+    }
+    else if (!was_stalled || !group.stall)
+    {
+        uint32_t instruction = 0, length = 0;
+        int64_t blockReads = 0;
+        FetchResult result = group.fetchBuffer.fetch(instructionMemory.data(), instructionMemory.size(),
+                                                     group.PC, instruction, length, blockReads);
+        bool fetched = (result == FETCH_OK);
+        if (fetched)
+        {
+            for (int l = 0; l < LANES; l++)
+                if_utilization[l] += active[l];
+            group.fetchLength = length;
+        }
+        else
+        {
+            group.fetchLength = (result == FETCH_BUBBLE) ? 0 : 4;
+        }
+        if (!group.stall)
+        {
+            group.ifValid = fetched;
+            group.ifIR = fetched ? instruction : 0;
+            group.ifPC = fetched ? group.PC : 0;
+            group.ifNPC = fetched ? group.PC + length : 0;
+        }
+    }
+
+    if (!group.stall && !group.branch_taken && !group.trapPending)
+        group.PC += group.fetchLength;
+
+    int owned = 0;
+    for (int l = 0; l < LANES; l++)
+    {
+        totalCycles[l] += active[l];
+        owned += active[l];
+    }
+    groupCycles++;
+    laneCycles += owned;
+
+    // Lanes that exited or faulted this cycle are finished; the rest carry on.
+    for (int l = 0; l < LANES; l++)
+    {
+        exited[l] |= group.exiting[l];
+        faulted[l] |= group.faulting[l];
+        group.active[l] &= !(group.exiting[l] | group.faulting[l]);
+        group.exiting[l] = 0;
+        group.faulting[l] = 0;
+    }
+}
+
+// Gives each group whose branch resolved this cycle the target PC of its
+// lanes, splitting off one group per distinct target.
+void BatchSimulator::splitGroups()
+{
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        BatchGroup &group = groups[g];
+        if (!group.branch_taken)
+            continue;
+        group.branch_taken = false;
+
+        int first = 0;
+        while (!group.active[first])
+            first++;
+        uint32_t target = group.branchPC[first];
+        group.PC = target;
+
+        BatchGroup rest = group;
+        bool diverged = false;
+        for (int l = 0; l < LANES; l++)
+        {
+            bool stays = group.branchPC[l] == target;
+            rest.active[l] = group.active[l] && !stays;
+            group.active[l] = group.active[l] && stays;
+            diverged |= rest.active[l] != 0;
+        }
+
+        if (diverged)
+        {
+            rest.branch_taken = true;
+            groups.push_back(rest);
+            splits++;
+        }
+    }
+}
+
+// Re-converges groups that have reached identical pipeline control state by
+// blending their per-lane latch values.
+void BatchSimulator::mergeGroups()
+{
+    for (size_t a = 0; a < groups.size(); a++)
+    {
+        for (size_t b = a + 1; b < groups.size();)
+        {
+            if (!sameControl(groups[a], groups[b]))
+            {
+                b++;
+                continue;
+            }
+
+            BatchGroup &into = groups[a];
+            const BatchGroup &from = groups[b];
+            for (int l = 0; l < LANES; l++)
+            {
+                bool take = from.active[l] != 0;
+                into.id_ex.A[l] = take ? from.id_ex.A[l] : into.id_ex.A[l];
+                into.id_ex.B[l] = take ? from.id_ex.B[l] : into.id_ex.B[l];
+                into.ex_mem.ALUOutput[l] = take ? from.ex_mem.ALUOutput[l] : into.ex_mem.ALUOutput[l];
+                into.ex_mem.B[l] = take ? from.ex_mem.B[l] : into.ex_mem.B[l];
+                into.mem_wb.ALUOutput[l] = take ? from.mem_wb.ALUOutput[l] : into.mem_wb.ALUOutput[l];
+                into.mem_wb.LMD[l] = take ? from.mem_wb.LMD[l] : into.mem_wb.LMD[l];
+                into.active[l] |= from.active[l];
+            }
+            groups.erase(groups.begin() + b);
+            merges++;
+        }
+    }
+}
+
+// Advances the groups fetching at the lowest PC by one cycle, so groups
+// that fell behind on a divergent path can catch up and merge. Lanes only
+// count the cycles they were stepped, which keeps their statistics equal to
+// a solo run.
+void BatchSimulator::runCycle()
+{
+    if (groups.empty())
+        return;
+
+    uint32_t minPC = groups[0].PC;
+    for (size_t g = 1; g < groups.size(); g++)
+        minPC = min(minPC, groups[g].PC);
+
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        if (groups[g].PC == minPC)
+            cycleGroup(groups[g]);
+    }
+
+    splitGroups();
+
+    for (size_t g = 0; g < groups.size();)
+    {
+        bool empty = true;
+        for (int l = 0; l < LANES; l++)
+            empty = empty && !groups[g].active[l];
+        if (empty || isGroupComplete(groups[g]))
+            groups.erase(groups.begin() + g);
+        else
+            g++;
+    }
+
+    if (groups.size() > 1)
+        mergeGroups();
+}
+
+// Steps until every lane has finished or maxCycles scheduler steps have
+// run; returns the number of steps.
+int BatchSimulator::run(int maxCycles)
+{
+    int executed = 0;
+    while (executed < maxCycles && !groups.empty())
+    {
+        runCycle();
+        executed++;
+    }
+    return executed;
+}
@@ -0,0 +1,183 @@
+#ifndef BATCH_SIMULATOR_H
+#define BATCH_SIMULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "riscv_simulator.h"
+
+#ifndef RISCV_BATCH_LANES
+#define RISCV_BATCH_LANES 16
+#endif
+
+// Pipeline latches of one lockstep group. Control fields (IR, PC, NPC, Imm,
+// valid) are shared by the lanes of the group; data fields hold one value
+// per lane.
+class BatchIDEX
+{
+public:
+    uint32_t IR;
+    uint32_t PC;
+    uint32_t NPC;
+    int32_t Imm;
+    bool valid;
+    int32_t A[RISCV_BATCH_LANES];
+    int32_t B[RISCV_BATCH_LANES];
+
+    BatchIDEX();
+};
+
+class BatchEXMEM
+{
+public:
+    uint32_t IR;
+    bool valid;
+    int32_t ALUOutput[RISCV_BATCH_LANES];
+    int32_t B[RISCV_BATCH_LANES];
+
+    BatchEXMEM();
+};
+
+class BatchMEMWB
+{
+public:
+    uint32_t IR;
+    bool valid;
+    int32_t ALUOutput[RISCV_BATCH_LANES];
+    int32_t LMD[RISCV_BATCH_LANES];
+
+    BatchMEMWB();
+};
+
+// Lanes whose control flow has agreed so far. active[] is 1 for the lanes
+// owned by the group and 0 otherwise, and is used to blend results into the
+// shared register file and memory.
+class BatchGroup
+{
+public:
+    int32_t active[RISCV_BATCH_LANES];
+    uint32_t PC;
+    bool stall;
+    bool squash_if_id;
+    bool branch_taken;
+    bool trapPending;
+
+    FetchBuffer fetchBuffer;
+    uint32_t fetchLength;
+
+    uint32_t ifIR;
+    uint32_t ifPC;
+    uint32_t ifNPC;
+    bool ifValid;
+
+    BatchIDEX id_ex;
+    BatchEXMEM ex_mem;
+    BatchMEMWB mem_wb;
+
+    // Per-lane PC chosen by a beq/jalr in EX this cycle, lanes whose ecall
+    // at WB this cycle was exit, and lanes with an illegal instruction in MEM.
+    uint32_t branchPC[RISCV_BATCH_LANES];
+    int32_t exiting[RISCV_BATCH_LANES];
+    int32_t faulting[RISCV_BATCH_LANES];
+
+    BatchGroup();
+};
+
+// Runs one program over up to LANES data images in lockstep. Registers and
+// data memory are stored lane-minor so each pipeline stage is a fixed-width
+// loop across lanes. When a beq or jalr resolves differently across lanes the
+// group is split, and groups that reach the same pipeline state are merged
+// again. Every lane produces the same registers, memory and counters as a
+// RISCVSimulator run on that image alone. System calls are emulated per
+// lane; guest output is kept per lane and reads see end of file.
+class BatchSimulator
+{
+public:
+    static const int LANES = RISCV_BATCH_LANES;
+
+    BatchSimulator();
+    bool loadProgram(const std::string &filename);
+    void reset(int laneCount = LANES);
+
+    // All lanes share one data memory size, grown to fit the largest image.
+    void setDataMemory(int lane, Span<int32_t> image);
+    void setDataWord(int lane, size_t index, int32_t value);
+    void setRegister(int lane, int reg, int32_t value);
+
+    void runCycle();
+    int run(int maxCycles);
+    bool isComplete() const { return groups.empty(); }
+
+    int getLaneCount() const { return laneCount; }
+    int32_t getRegister(int lane, int reg) const { return registers[reg][lane]; }
+    int32_t getDataWord(int lane, size_t index) const { return dataMemory[index * LANES + lane]; }
+    size_t getDataMemorySize() const { return dataWords; }
+
+    int64_t getTotalCycles(int lane) const { return totalCycles[lane]; }
+    int64_t getInstructionsCompleted(int lane) const { return instructionsCompleted[lane]; }
+    int64_t getIFUtilization(int lane) const { return if_utilization[lane]; }
+    int64_t getIDUtilization(int lane) const { return id_utilization[lane]; }
+    int64_t getEXUtilization(int lane) const { return ex_utilization[lane]; }
+    int64_t getMEMUtilization(int lane) const { return mem_utilization[lane]; }
+    int64_t getWBUtilization(int lane) const { return wb_utilization[lane]; }
+
+    bool hasExited(int lane) const { return exited[lane] != 0; }
+    int32_t getExitCode(int lane) const { return exitCode[lane]; }
+    bool hasFaulted(int lane) const { return faulted[lane] != 0; }
+    const std::string &getOutput(int lane) const { return output[lane]; }
+
+    int getGroupCount() const { return groups.size(); }
+    int getSplitCount() const { return splits; }
+    int getMergeCount() const { return merges; }
+    // Fraction of lane slots doing useful work across all group cycles.
+    double getLockstepEfficiency() const;
+
+private:
+    std::vector<uint32_t> instructionMemory;
+    std::vector<int32_t> dataMemory;
+    size_t dataWords;
+    uint32_t entryPC;
+    uint32_t initialBreak;
+    int laneCount;
+
+    int32_t registers[32][LANES];
+
+    int64_t totalCycles[LANES];
+    int64_t if_utilization[LANES];
+    int64_t id_utilization[LANES];
+    int64_t ex_utilization[LANES];
+    int64_t mem_utilization[LANES];
+    int64_t wb_utilization[LANES];
+    int64_t instructionsCompleted[LANES];
+
+    int32_t exited[LANES];
+    int32_t exitCode[LANES];
+    int32_t faulted[LANES];
+    uint32_t programBreak[LANES];
+    std::string output[LANES];
+
+    std::vector<BatchGroup> groups;
+    int64_t groupCycles;
+    int64_t laneCycles;
+    int splits;
+    int merges;
+
+    class LaneGuest;
+    void resizeDataMemory(size_t words);
+    bool fetchable(uint32_t pc) const;
+    bool isGroupComplete(const BatchGroup &group) const;
+    bool sameControl(const BatchGroup &a, const BatchGroup &b) const;
+
+    void cycleGroup(BatchGroup &group);
+    void WB_stage(BatchGroup &group);
+    void MEM_stage(BatchGroup &group, BatchMEMWB &next);
+    void EX_stage(BatchGroup &group, BatchEXMEM &next);
+    void ID_stage(BatchGroup &group, BatchIDEX &next);
+
+    void splitGroups();
+    void mergeGroups();
+};
+
+#endif
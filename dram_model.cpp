@@ -0,0 +1,221 @@
+#include "dram_model.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+bool parseDramConfig(const string &spec, DramConfig &config)
+{
+    DramConfig parsed = config;
+    size_t begin = 0;
+    while (begin < spec.size())
+    {
+        size_t end = spec.find(',', begin);
+        if (end == string::npos)
+            end = spec.size();
+        string item = spec.substr(begin, end - begin);
+        begin = end + 1;
+
+        size_t equals = item.find('=');
+        if (equals == string::npos)
+            return false;
+        string key = item.substr(0, equals);
+        string value = item.substr(equals + 1);
+
+        if (key == "policy")
+        {
+            if (value == "open")
+                parsed.policy = PAGE_OPEN;
+            else if (value == "closed")
+                parsed.policy = PAGE_CLOSED;
+            else
+                return false;
+            continue;
+        }
+
+        char *rest;
+        unsigned long number = strtoul(value.c_str(), &rest, 10);
+        if (value.empty() || *rest != '\0')
+            return false;
+
+        if (key == "channels")
+            parsed.channels = number;
+        else if (key == "banks")
+            parsed.banks = number;
+        else if (key == "row")
+            parsed.rowBytes = number;
+        else if (key == "trcd")
+            parsed.tRCD = number;
+        else if (key == "tcas")
+            parsed.tCAS = number;
+        else if (key == "trp")
+            parsed.tRP = number;
+        else if (key == "burst")
+            parsed.tBurst = number;
+        else
+            return false;
+    }
+    config = parsed;
+    return true;
+}
+
+DramModel::DramModel() : enabled(false)
+{
+    reset();
+}
+
+bool DramModel::configure(const DramConfig &newConfig)
+{
+    if (newConfig.channels < 1 || newConfig.channels > RISCV_DRAM_MAX_CHANNELS ||
+        newConfig.banks < 1 || newConfig.banks > RISCV_DRAM_MAX_BANKS ||
+        newConfig.rowBytes == 0 || newConfig.tBurst == 0)
+        return false;
+
+    config = newConfig;
+    enabled = true;
+    reset();
+    return true;
+}
+
+void DramModel::reset()
+{
+    for (int c = 0; c < RISCV_DRAM_MAX_CHANNELS; c++)
+    {
+        for (int b = 0; b < RISCV_DRAM_MAX_BANKS; b++)
+        {
+            banks[c][b].openRow = NO_ROW;
+            banks[c][b].ready = 0;
+        }
+        commandReady[c] = 0;
+        busReady[c] = 0;
+    }
+    memset(queue, 0, sizeof(queue));
+    nextOrder = 0;
+    nextEvent = PENDING;
+    requests = rowHits = rowMisses = bankConflicts = totalLatency = 0;
+}
+
+int DramModel::request(uint32_t address, uint64_t now)
+{
+    int slot = 0;
+    while (slot < QUEUE_DEPTH && queue[slot].valid)
+        slot++;
+    if (slot == QUEUE_DEPTH)
+        return -1;
+
+    uint32_t unit = address / config.rowBytes;
+    Request &request = queue[slot];
+    request.channel = unit % config.channels;
+    unit /= config.channels;
+    request.bank = unit % config.banks;
+    request.row = unit / config.banks;
+    request.arrival = now;
+    request.done = PENDING;
+    request.order = nextOrder++;
+    request.valid = true;
+    request.issued = false;
+
+    nextEvent = min(nextEvent, now);
+    return slot;
+}
+
+int DramModel::getFreeSlots() const
+{
+    int free = 0;
+    for (int i = 0; i < QUEUE_DEPTH; i++)
+        free += !queue[i].valid;
+    return free;
+}
+
+void DramModel::schedule(uint64_t now)
+{
+    nextEvent = PENDING;
+    for (int c = 0; c < config.channels; c++)
+        nextEvent = min(nextEvent, scheduleChannel(c, now));
+}
+
+// Issues the channel's requests in FR-FCFS order up to cycle now, at the
+// cycles they would have issued had the model been ticked every cycle.
+// Returns the next cycle the channel could issue, or PENDING if it is idle.
+uint64_t DramModel::scheduleChannel(int channel, uint64_t now)
+{
+    for (;;)
+    {
+        uint64_t start = PENDING;
+        for (int i = 0; i < QUEUE_DEPTH; i++)
+        {
+            const Request &request = queue[i];
+            if (request.valid && !request.issued && request.channel == channel)
+                start = min(start, max(request.arrival, banks[channel][request.bank].ready));
+        }
+        if (start == PENDING)
+            return PENDING;
+        start = max(start, commandReady[channel]);
+        if (start > now)
+            return start;
+
+        int pick = -1;
+        bool pickHit = false;
+        for (int i = 0; i < QUEUE_DEPTH; i++)
+        {
+            const Request &request = queue[i];
+            const Bank &bank = banks[channel][request.bank];
+            if (!request.valid || request.issued || request.channel != channel ||
+                request.arrival > start || bank.ready > start)
+                continue;
+
+            bool hit = (bank.openRow == request.row);
+            if (pick < 0 || (hit && !pickHit) || (hit == pickHit && request.order < queue[pick].order))
+            {
+                pick = i;
+                pickHit = hit;
+            }
+        }
+
+        issue(queue[pick], start);
+        commandReady[channel] = start + 1;
+    }
+}
+
+void DramModel::issue(Request &request, uint64_t cycle)
+{
+    Bank &bank = banks[request.channel][request.bank];
+
+    uint32_t activate = 0;
+    if (bank.openRow == request.row)
+    {
+        rowHits++;
+    }
+    else if (bank.openRow == NO_ROW)
+    {
+        activate = config.tRCD;
+        rowMisses++;
+    }
+    else
+    {
+        activate = config.tRP + config.tRCD;
+        bankConflicts++;
+    }
+
+    uint64_t dataStart = max(cycle + activate + config.tCAS, busReady[request.channel]);
+    request.done = dataStart + config.tBurst;
+    request.issued = true;
+    busReady[request.channel] = request.done;
+
+    if (config.policy == PAGE_OPEN)
+    {
+        // Further column commands to the open row follow one burst apart.
+        bank.openRow = request.row;
+        bank.ready = cycle + activate + config.tBurst;
+    }
+    else
+    {
+        bank.openRow = NO_ROW;
+        bank.ready = request.done + config.tRP;
+    }
+
+    requests++;
+    totalLatency += request.done - request.arrival;
+}
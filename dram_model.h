@@ -0,0 +1,138 @@
+#ifndef DRAM_MODEL_H
+#define DRAM_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifndef RISCV_DRAM_MAX_CHANNELS
+#define RISCV_DRAM_MAX_CHANNELS 4
+#endif
+
+#ifndef RISCV_DRAM_MAX_BANKS
+#define RISCV_DRAM_MAX_BANKS 16
+#endif
+
+#ifndef RISCV_DRAM_QUEUE_DEPTH
+#define RISCV_DRAM_QUEUE_DEPTH 16
+#endif
+
+enum PagePolicy
+{
+    PAGE_OPEN,  // rows stay open until another row of the bank is needed
+    PAGE_CLOSED // every access precharges its bank when it finishes
+};
+
+// Geometry and timings, in core cycles. Addresses are split as
+// row | bank | channel | column, so consecutive bytes share a row and
+// consecutive rows alternate channels, then banks.
+struct DramConfig
+{
+    int channels;
+    int banks; // per channel
+    uint32_t rowBytes;
+    uint32_t tRCD; // activate to column command
+    uint32_t tCAS; // column command to data
+    uint32_t tRP;  // precharge
+    uint32_t tBurst;
+    PagePolicy policy;
+
+    DramConfig()
+        : channels(1), banks(8), rowBytes(2048), tRCD(14), tCAS(14), tRP(14), tBurst(4),
+          policy(PAGE_OPEN) {}
+};
+
+// Parses "channels=2,banks=8,row=2048,trcd=14,tcas=14,trp=14,burst=4,policy=closed".
+// Keys that are left out keep their current value.
+bool parseDramConfig(const std::string &spec, DramConfig &config);
+
+// Event-driven DRAM timing model with one FR-FCFS request queue: each
+// channel issues at most one request per cycle, preferring the oldest row hit
+// over the oldest request. Requests are issued lazily: advance(now) only does
+// work once now reaches the next cycle at which a queued request could issue,
+// and every issue computes the request's completion cycle directly instead of
+// ticking bank state.
+//
+// The model has no pointers or heap storage, so the simulator copies it
+// whole for checkpoints and undo.
+class DramModel
+{
+public:
+    static const int QUEUE_DEPTH = RISCV_DRAM_QUEUE_DEPTH;
+    static const uint64_t PENDING = UINT64_MAX;
+
+    DramModel();
+
+    // Enabling (or reconfiguring) the model resets it.
+    bool configure(const DramConfig &config);
+    void disable() { enabled = false; }
+    bool isEnabled() const { return enabled; }
+    const DramConfig &getConfig() const { return config; }
+    void reset();
+
+    // Queues an access arriving at cycle now and returns its slot, or -1 if
+    // the queue is full. The slot stays taken until release().
+    int request(uint32_t address, uint64_t now);
+    void release(int slot) { queue[slot].valid = false; }
+    int getFreeSlots() const;
+
+    // Issues every request that could start at or before now.
+    void advance(uint64_t now)
+    {
+        if (now >= nextEvent)
+            schedule(now);
+    }
+
+    // Cycle the data of a request has arrived by, or PENDING while queued.
+    uint64_t completion(int slot) const { return queue[slot].done; }
+
+    uint64_t getRequests() const { return requests; }
+    uint64_t getRowHits() const { return rowHits; }
+    uint64_t getRowMisses() const { return rowMisses; }
+    uint64_t getBankConflicts() const { return bankConflicts; }
+    double getRowHitRate() const { return requests ? (double)rowHits / requests : 0.0; }
+    double getAverageLatency() const { return requests ? (double)totalLatency / requests : 0.0; }
+
+private:
+    static const uint32_t NO_ROW = 0xFFFFFFFF;
+
+    struct Bank
+    {
+        uint32_t openRow;
+        uint64_t ready; // first cycle a new command may start
+    };
+
+    struct Request
+    {
+        uint32_t row;
+        uint64_t arrival;
+        uint64_t done;
+        uint64_t order;
+        uint8_t channel;
+        uint8_t bank;
+        bool valid;
+        bool issued;
+    };
+
+    DramConfig config;
+    bool enabled;
+
+    Bank banks[RISCV_DRAM_MAX_CHANNELS][RISCV_DRAM_MAX_BANKS];
+    uint64_t commandReady[RISCV_DRAM_MAX_CHANNELS];
+    uint64_t busReady[RISCV_DRAM_MAX_CHANNELS];
+    Request queue[QUEUE_DEPTH];
+    uint64_t nextOrder;
+    uint64_t nextEvent;
+
+    uint64_t requests;
+    uint64_t rowHits;
+    uint64_t rowMisses;
+    uint64_t bankConflicts;
+    uint64_t totalLatency;
+
+    void schedule(uint64_t now);
+    uint64_t scheduleChannel(int channel, uint64_t now);
+    void issue(Request &request, uint64_t cycle);
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "fetch_unit.h"
+
+static uint32_t bits(uint32_t value, int high, int low)
+{
+    return (value >> low) & ((1u << (high - low + 1)) - 1);
+}
+
+static int32_t signExtend(uint32_t value, int width)
+{
+    return (int32_t)(value << (32 - width)) >> (32 - width);
+}
+
+static uint32_t encodeR(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static uint32_t encodeI(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+    return ((uint32_t)(imm & 0xFFF) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static uint32_t encodeS(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3)
+{
+    uint32_t u = (uint32_t)imm;
+    return (bits(u, 11, 5) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (bits(u, 4, 0) << 7) | 0x23;
+}
+
+static uint32_t encodeB(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3)
+{
+    uint32_t u = (uint32_t)imm;
+    return (bits(u, 12, 12) << 31) | (bits(u, 10, 5) << 25) | (rs2 << 20) | (rs1 << 15) |
+           (funct3 << 12) | (bits(u, 4, 1) << 8) | (bits(u, 11, 11) << 7) | 0x63;
+}
+
+static uint32_t encodeJ(int32_t imm, uint32_t rd)
+{
+    uint32_t u = (uint32_t)imm;
+    return (bits(u, 20, 20) << 31) | (bits(u, 10, 1) << 21) | (bits(u, 11, 11) << 20) |
+           (bits(u, 19, 12) << 12) | (rd << 7) | 0x6F;
+}
+
+// Offset of c.j/c.jal: imm[11|4|9:8|10|6|7|3:1|5] in bits 12:2.
+static int32_t immCJ(uint32_t c)
+{
+    uint32_t imm = (bits(c, 12, 12) << 11) | (bits(c, 11, 11) << 4) | (bits(c, 10, 9) << 8) |
+                   (bits(c, 8, 8) << 10) | (bits(c, 7, 7) << 6) | (bits(c, 6, 6) << 7) |
+                   (bits(c, 5, 3) << 1) | (bits(c, 2, 2) << 5);
+    return signExtend(imm, 12);
+}
+
+// Offset of c.beqz/c.bnez: imm[8|4:3] in bits 12:10, imm[7:6|2:1|5] in 6:2.
+static int32_t immCB(uint32_t c)
+{
+    uint32_t imm = (bits(c, 12, 12) << 8) | (bits(c, 11, 10) << 3) | (bits(c, 6, 5) << 6) |
+                   (bits(c, 4, 3) << 1) | (bits(c, 2, 2) << 5);
+    return signExtend(imm, 9);
+}
+
+uint32_t expandCompressed(uint16_t instruction)
+{
+    uint32_t c = instruction;
+    uint32_t funct3 = bits(c, 15, 13);
+    uint32_t rd = bits(c, 11, 7);
+    uint32_t rs2 = bits(c, 6, 2);
+    uint32_t rdp = bits(c, 4, 2) + 8;  // rd'/rs2'
+    uint32_t rs1p = bits(c, 9, 7) + 8; // rs1'/rd'
+    int32_t imm6 = signExtend((bits(c, 12, 12) << 5) | bits(c, 6, 2), 6);
+    uint32_t shamt = (bits(c, 12, 12) << 5) | bits(c, 6, 2);
+
+    switch (bits(c, 1, 0))
+    {
+    case 0x0:
+    {
+        // c.lw/c.sw offset: uimm[5:3] in 12:10, uimm[2] in 6, uimm[6] in 5.
+        int32_t offset = (bits(c, 12, 10) << 3) | (bits(c, 6, 6) << 2) | (bits(c, 5, 5) << 6);
+        if (funct3 == 0x0)
+        { // c.addi4spn
+            int32_t imm = (bits(c, 12, 11) << 4) | (bits(c, 10, 7) << 6) |
+                          (bits(c, 6, 6) << 2) | (bits(c, 5, 5) << 3);
+            return imm ? encodeI(imm, 2, 0x0, rdp, 0x13) : ILLEGAL_INSTRUCTION;
+        }
+        if (funct3 == 0x2) // c.lw
+            return encodeI(offset, rs1p, 0x2, rdp, 0x03);
+        if (funct3 == 0x6) // c.sw
+            return encodeS(offset, rdp, rs1p, 0x2);
+        return ILLEGAL_INSTRUCTION;
+    }
+
+    case 0x1:
+        switch (funct3)
+        {
+        case 0x0: // c.addi / c.nop
+            return encodeI(imm6, rd, 0x0, rd, 0x13);
+        case 0x1: // c.jal
+            return encodeJ(immCJ(c), 1);
+        case 0x2: // c.li
+            return encodeI(imm6, 0, 0x0, rd, 0x13);
+        case 0x3:
+            if (rd == 2)
+            { // c.addi16sp: nzimm[9] in 12, nzimm[4|6|8:7|5] in 6:2
+                int32_t imm = signExtend((bits(c, 12, 12) << 9) | (bits(c, 6, 6) << 4) |
+                                             (bits(c, 5, 5) << 6) | (bits(c, 4, 3) << 7) |
+                                             (bits(c, 2, 2) << 5),
+                                         10);
+                return imm ? encodeI(imm, 2, 0x0, 2, 0x13) : ILLEGAL_INSTRUCTION;
+            }
+            // c.lui
+            if (imm6 == 0)
+                return ILLEGAL_INSTRUCTION;
+            return ((uint32_t)imm6 << 12) | (rd << 7) | 0x37;
+        case 0x4:
+            switch (bits(c, 11, 10))
+            {
+            case 0x0: // c.srli
+                return bits(c, 12, 12) ? ILLEGAL_INSTRUCTION : encodeR(0x00, shamt, rs1p, 0x5, rs1p, 0x13);
+            case 0x1: // c.srai: EX only shifts logically
+                return ILLEGAL_INSTRUCTION;
+            case 0x2: // c.andi
+                return encodeI(imm6, rs1p, 0x7, rs1p, 0x13);
+            default:
+                if (bits(c, 12, 12))
+                    return ILLEGAL_INSTRUCTION;
+                switch (bits(c, 6, 5))
+                {
+                case 0x0: // c.sub
+                    return encodeR(0x20, rdp, rs1p, 0x0, rs1p, 0x33);
+                case 0x1: // c.xor: EX has no xor
+                    return ILLEGAL_INSTRUCTION;
+                case 0x2: // c.or
+                    return encodeR(0x00, rdp, rs1p, 0x6, rs1p, 0x33);
+                default: // c.and
+                    return encodeR(0x00, rdp, rs1p, 0x7, rs1p, 0x33);
+                }
+            }
+        case 0x5: // c.j
+            return encodeJ(immCJ(c), 0);
+        case 0x6: // c.beqz
+            return encodeB(immCB(c), 0, rs1p, 0x0);
+        default: // c.bnez: EX only takes beq
+            return ILLEGAL_INSTRUCTION;
+        }
+
+    case 0x2:
+        switch (funct3)
+        {
+        case 0x0: // c.slli
+            return bits(c, 12, 12) ? ILLEGAL_INSTRUCTION : encodeR(0x00, shamt, rd, 0x1, rd, 0x13);
+        case 0x2:
+        { // c.lwsp: uimm[5] in 12, uimm[4:2] in 6:4, uimm[7:6] in 3:2
+            int32_t offset = (bits(c, 12, 12) << 5) | (bits(c, 6, 4) << 2) | (bits(c, 3, 2) << 6);
+            return rd ? encodeI(offset, 2, 0x2, rd, 0x03) : ILLEGAL_INSTRUCTION;
+        }
+        case 0x4:
+            if (!bits(c, 12, 12))
+            {
+                if (rs2 == 0) // c.jr
+                    return rd ? encodeI(0, rd, 0x0, 0, 0x67) : ILLEGAL_INSTRUCTION;
+                return encodeR(0x00, rs2, 0, 0x0, rd, 0x33); // c.mv
+            }
+            if (rs2 == 0)
+            {
+                if (rd == 0) // c.ebreak
+                    return 0x00100073;
+                return encodeI(0, rd, 0x0, 1, 0x67); // c.jalr
+            }
+            return encodeR(0x00, rs2, rd, 0x0, rd, 0x33); // c.add
+        case 0x6:
+        { // c.swsp: uimm[5:2] in 12:9, uimm[7:6] in 8:7
+            int32_t offset = (bits(c, 12, 9) << 2) | (bits(c, 8, 7) << 6);
+            return encodeS(offset, rs2, 2, 0x2);
+        }
+        default:
+            return ILLEGAL_INSTRUCTION;
+        }
+    }
+    return ILLEGAL_INSTRUCTION;
+}
+
+FetchResult FetchBuffer::fetch(const uint32_t *memory, size_t words, uint32_t pc,
+                               uint32_t &instruction, uint32_t &length, int64_t &blockReads)
+{
+    bool blockRead = false;
+    if (!holds(pc))
+    {
+        start = pc & ~(BLOCK_BYTES - 1);
+        end = start + BLOCK_BYTES;
+        blockReads++;
+        blockRead = true;
+    }
+
+    uint16_t low = readParcel(memory, words, pc);
+    if (low == 0)
+        return FETCH_EMPTY;
+
+    if (isCompressed(low))
+    {
+        instruction = expandCompressed(low);
+        length = 2;
+        return FETCH_OK;
+    }
+
+    if (!holds(pc + 2))
+    {
+        if (blockRead)
+            return FETCH_BUBBLE;
+        start = end - 2;
+        end += BLOCK_BYTES;
+        blockReads++;
+    }
+    instruction = low | ((uint32_t)readParcel(memory, words, pc + 2) << 16);
+    length = 4;
+    return FETCH_OK;
+}
@@ -0,0 +1,65 @@
+#ifndef FETCH_UNIT_H
+#define FETCH_UNIT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef RISCV_FETCH_BLOCK_BYTES
+#define RISCV_FETCH_BLOCK_BYTES 8
+#endif
+
+// Expands an RV32C instruction to the 32-bit instruction it stands for, or
+// returns ILLEGAL_INSTRUCTION if it has none (reserved or RV64/FP encodings)
+// or if EX does not implement it (c.srai, c.xor, c.bnez).
+uint32_t expandCompressed(uint16_t instruction);
+
+// IR of an instruction that could not be decoded. It travels down the
+// pipeline like any other, so a wrong-path one is squashed, and faults the
+// simulator when it reaches MEM.
+const uint32_t ILLEGAL_INSTRUCTION = 0;
+
+inline bool isCompressed(uint16_t parcel)
+{
+    return (parcel & 0x3) != 0x3;
+}
+
+// Returns the 16-bit parcel at byte address pc of instruction memory, or 0
+// past the end.
+inline uint16_t readParcel(const uint32_t *memory, size_t words, uint32_t pc)
+{
+    if (pc / 4 >= words)
+        return 0;
+    return (uint16_t)(memory[pc / 4] >> (8 * (pc & 0x2)));
+}
+
+enum FetchResult
+{
+    FETCH_EMPTY,  // no instruction at PC
+    FETCH_BUBBLE, // instruction spans a block that could not be read yet
+    FETCH_OK
+};
+
+// Fetch buffer holding one aligned block of instruction memory plus the last
+// parcel of the block before it, so a 32-bit instruction straddling two
+// blocks can issue after a single block read. One block is read per cycle;
+// an instruction that needs two new blocks (a jump to the last parcel of a
+// block) costs a bubble.
+class FetchBuffer
+{
+public:
+    static const uint32_t BLOCK_BYTES = RISCV_FETCH_BLOCK_BYTES;
+
+    uint32_t start;
+    uint32_t end;
+
+    FetchBuffer() : start(0), end(0) {}
+
+    bool holds(uint32_t pc) const { return pc >= start && pc + 2 <= end; }
+
+    // Fetches the instruction at pc, expanding compressed instructions.
+    // blockReads is incremented for every block read from memory.
+    FetchResult fetch(const uint32_t *memory, size_t words, uint32_t pc,
+                      uint32_t &instruction, uint32_t &length, int64_t &blockReads);
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "kanata_exporter.h"
+#include "riscv_simulator.h"
+
+using namespace std;
+
+static const char STAGE_IF[] = "F";
+static const char STAGE_ID[] = "D";
+static const char STAGE_EX[] = "X";
+static const char STAGE_MEM[] = "M";
+static const char STAGE_WB[] = "W";
+
+static char *writeDecimal(char *out, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0)
+        *out++ = digits[--count];
+    return out;
+}
+
+static char *writeHex8(char *out, uint32_t value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    for (int shift = 28; shift >= 0; shift -= 4)
+        *out++ = hexDigits[(value >> shift) & 0xF];
+    return out;
+}
+
+KanataExporter::KanataExporter()
+    : file(nullptr), nextId(0), retired(0), started(false), stopping(false)
+{
+}
+
+KanataExporter::~KanataExporter()
+{
+    close();
+}
+
+bool KanataExporter::open(const string &filename)
+{
+    close();
+    file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+
+    chunk.reserve(CHUNK_SIZE + 256);
+    inFlight.clear();
+    completions.clear();
+    nextId = 0;
+    retired = 0;
+    started = false;
+    stopping = false;
+    writer = thread(&KanataExporter::writerLoop, this);
+
+    append("Kanata\t0004\n");
+    return true;
+}
+
+void KanataExporter::close()
+{
+    if (!file)
+        return;
+
+    submitChunk();
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    chunkReady.notify_one();
+    writer.join();
+
+    fclose(file);
+    file = nullptr;
+}
+
+void KanataExporter::append(const char *text)
+{
+    chunk.append(text);
+    if (chunk.size() >= CHUNK_SIZE)
+        submitChunk();
+}
+
+// Appends "<command>\t<seq>\t<a>\t<b>\n" where b is a stage name or number.
+void KanataExporter::appendRecord(char command, uint64_t seq, uint64_t a, const char *b)
+{
+    char line[64];
+    char *out = line;
+    *out++ = command;
+    *out++ = '\t';
+    out = writeDecimal(out, seq);
+    *out++ = '\t';
+    out = writeDecimal(out, a);
+    *out++ = '\t';
+    while (*b)
+        *out++ = *b++;
+    *out++ = '\n';
+    chunk.append(line, out - line);
+
+    if (chunk.size() >= CHUNK_SIZE)
+        submitChunk();
+}
+
+void KanataExporter::submitChunk()
+{
+    if (chunk.empty())
+        return;
+
+    string next;
+    {
+        unique_lock<mutex> lock(queueMutex);
+        chunkWritten.wait(lock, [this]
+                          { return pending.size() < MAX_PENDING_CHUNKS; });
+        pending.push_back(string());
+        pending.back().swap(chunk);
+        if (!spare.empty())
+        {
+            next.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+    chunkReady.notify_one();
+
+    chunk.swap(next);
+    chunk.clear();
+    chunk.reserve(CHUNK_SIZE + 256);
+}
+
+void KanataExporter::writerLoop()
+{
+    unique_lock<mutex> lock(queueMutex);
+    while (true)
+    {
+        chunkReady.wait(lock, [this]
+                        { return stopping || !pending.empty(); });
+        if (pending.empty())
+            break;
+
+        string data;
+        data.swap(pending.front());
+        pending.pop_front();
+
+        lock.unlock();
+        fwrite(data.data(), 1, data.size(), file);
+        data.clear();
+        lock.lock();
+
+        spare.push_back(string());
+        spare.back().swap(data);
+        chunkWritten.notify_one();
+    }
+}
+
+KanataExporter::InFlight *KanataExporter::find(uint64_t seq)
+{
+    for (size_t i = 0; i < inFlight.size(); i++)
+    {
+        if (inFlight[i].seq == seq)
+            return &inFlight[i];
+    }
+    return nullptr;
+}
+
+void KanataExporter::moveTo(uint64_t seq, const char *stage)
+{
+    InFlight *entry = find(seq);
+    if (!entry || entry->stage == stage)
+        return;
+
+    appendRecord('E', entry->id, 0, entry->stage);
+    appendRecord('S', entry->id, 0, stage);
+    entry->stage = stage;
+}
+
+// Closes the record for entry; the caller removes it from inFlight.
+void KanataExporter::finish(InFlight &entry, bool flushed)
+{
+    appendRecord('E', entry.id, 0, entry.stage);
+    if (flushed)
+        appendRecord('R', entry.id, 0, "1");
+    else
+        appendRecord('R', entry.id, retired++, "0");
+}
+
+void KanataExporter::onFetch(int64_t cycle, uint64_t seq, uint32_t pc, uint32_t instruction)
+{
+    if (!started)
+    {
+        append(("C=\t" + to_string(cycle) + "\n").c_str());
+        started = true;
+    }
+
+    InFlight entry = {seq, nextId++, STAGE_IF, 0};
+    inFlight.push_back(entry);
+
+    char label[20];
+    char *out = writeHex8(label, pc);
+    *out++ = ':';
+    *out++ = ' ';
+    out = writeHex8(out, instruction);
+    *out = '\0';
+
+    appendRecord('I', entry.id, seq, "0");
+    appendRecord('L', entry.id, 0, label);
+    appendRecord('S', entry.id, 0, STAGE_IF);
+}
+
+void KanataExporter::onIssue(int64_t /*cycle*/, uint64_t seq, uint32_t /*instruction*/)
+{
+    InFlight *entry = find(seq);
+    if (entry && entry->stallCycles > 0)
+    {
+        string label = "stalled " + to_string(entry->stallCycles) + " cycles in ID";
+        appendRecord('L', entry->id, 1, label.c_str());
+    }
+}
+
+void KanataExporter::onStall(int64_t /*cycle*/, uint64_t seq, uint32_t /*instruction*/)
+{
+    InFlight *entry = find(seq);
+    if (entry)
+        entry->stallCycles++;
+}
+
+void KanataExporter::onFlush(int64_t /*cycle*/, uint64_t seq, uint32_t /*instruction*/)
+{
+    Completion completion = {seq, true};
+    completions.push_back(completion);
+}
+
+void KanataExporter::onRetire(int64_t /*cycle*/, uint64_t seq, uint32_t /*instruction*/)
+{
+    Completion completion = {seq, false};
+    completions.push_back(completion);
+}
+
+// Called after the latches update: records that finished during the cycle are
+// closed, then every latched instruction is moved to the stage it occupies in
+// the next cycle.
+void KanataExporter::onCycleEnd(const RISCVSimulator &sim)
+{
+    if (!started)
+        return;
+
+    append("C\t1\n");
+
+    for (size_t i = 0; i < completions.size(); i++)
+    {
+        InFlight *entry = find(completions[i].seq);
+        if (!entry)
+            continue;
+
+        finish(*entry, completions[i].flushed);
+        *entry = inFlight.back();
+        inFlight.pop_back();
+    }
+    completions.clear();
+
+    if (sim.getMEMWB().valid)
+        moveTo(sim.getMEMWB().seq, STAGE_WB);
+    if (sim.getEXMEM().valid)
+        moveTo(sim.getEXMEM().seq, STAGE_MEM);
+    if (sim.getIDEX().valid)
+        moveTo(sim.getIDEX().seq, STAGE_EX);
+    if (sim.getIFID().valid)
+        moveTo(sim.getIFID().seq, STAGE_ID);
+}
+
+// The instructions in flight at the rewound-to cycle were fetched in a
+// future the log has already recorded, so they are closed as flushed and
+// left untracked; anything fetched from here on is a new record.
+void KanataExporter::onRewind(int64_t /*cycle*/)
+{
+    for (size_t i = 0; i < inFlight.size(); i++)
+        finish(inFlight[i], true);
+    inFlight.clear();
+    completions.clear();
+}
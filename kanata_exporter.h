@@ -0,0 +1,80 @@
+#ifndef KANATA_EXPORTER_H
+#define KANATA_EXPORTER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim_observer.h"
+
+// Streams a Kanata 0004 pipeline log (viewable in Konata) while the
+// simulation runs. Records are appended to an in-memory chunk; full chunks are
+// handed to a writer thread, so the simulation thread never touches the file.
+// The log cannot be rewound: stepping backwards flushes every instruction in
+// flight, and those fetched afterwards get new ids in the log.
+class KanataExporter : public SimObserver
+{
+public:
+    KanataExporter();
+    ~KanataExporter();
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    void onFetch(int64_t cycle, uint64_t seq, uint32_t pc, uint32_t instruction);
+    void onIssue(int64_t cycle, uint64_t seq, uint32_t instruction);
+    void onStall(int64_t cycle, uint64_t seq, uint32_t instruction);
+    void onFlush(int64_t cycle, uint64_t seq, uint32_t instruction);
+    void onRetire(int64_t cycle, uint64_t seq, uint32_t instruction);
+    void onCycleEnd(const RISCVSimulator &sim);
+    void onRewind(int64_t cycle);
+
+private:
+    struct InFlight
+    {
+        uint64_t seq;
+        uint64_t id;
+        const char *stage;
+        int stallCycles;
+    };
+
+    struct Completion
+    {
+        uint64_t seq;
+        bool flushed;
+    };
+
+    static const size_t CHUNK_SIZE = 1 << 20;
+    static const size_t MAX_PENDING_CHUNKS = 8;
+
+    FILE *file;
+    std::string chunk;
+    std::vector<InFlight> inFlight;
+    std::vector<Completion> completions;
+    uint64_t nextId;
+    uint64_t retired;
+    bool started;
+
+    std::thread writer;
+    std::mutex queueMutex;
+    std::condition_variable chunkReady;
+    std::condition_variable chunkWritten;
+    std::deque<std::string> pending;
+    std::vector<std::string> spare;
+    bool stopping;
+
+    InFlight *find(uint64_t seq);
+    void moveTo(uint64_t seq, const char *stage);
+    void finish(InFlight &entry, bool flushed);
+    void append(const char *text);
+    void appendRecord(char command, uint64_t seq, uint64_t a, const char *b);
+    void submitChunk();
+    void writerLoop();
+};
+
+#endif
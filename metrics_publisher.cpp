@@ -0,0 +1,120 @@
+#include "metrics_publisher.h"
+#include "riscv_simulator.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static uint64_t hostNanoseconds()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MetricsPublisher::MetricsPublisher() : segment(nullptr), lastInstructions(0), lastNanoseconds(0)
+{
+}
+
+MetricsPublisher::~MetricsPublisher()
+{
+    close();
+}
+
+bool MetricsPublisher::open(const string &segmentName, int interval)
+{
+    close();
+#ifndef _WIN32
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(MetricsSegment)) != 0)
+    {
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+    void *addr = mmap(nullptr, sizeof(MetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        shm_unlink(segmentName.c_str());
+        return false;
+    }
+
+    // A reader only attaches once magic is set, after the rest is in place.
+    segment = static_cast<MetricsSegment *>(addr);
+    segment->magic = 0;
+    atomic_thread_fence(memory_order_release);
+    segment->version = MetricsSegment::VERSION;
+    segment->pid = getpid();
+    segment->interval = interval;
+    segment->published.store(0, memory_order_relaxed);
+    for (int i = 0; i < MetricsSegment::SLOTS; i++)
+        segment->slots[i].sequence.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    segment->magic = MetricsSegment::MAGIC;
+
+    name = segmentName;
+    lastInstructions = 0;
+    lastNanoseconds = hostNanoseconds();
+    return true;
+#else
+    cerr << "Error: Shared-memory metrics are not supported on this platform" << endl;
+    return false;
+#endif
+}
+
+void MetricsPublisher::close()
+{
+#ifndef _WIN32
+    if (segment)
+    {
+        munmap(segment, sizeof(MetricsSegment));
+        shm_unlink(name.c_str());
+    }
+#endif
+    segment = nullptr;
+}
+
+void MetricsPublisher::publish(const RISCVSimulator &sim)
+{
+    if (!segment)
+        return;
+
+    MetricsSample sample;
+    sample.totalCycles = sim.getTotalCycles();
+    sample.instructionsCompleted = sim.getInstructionsCompleted();
+    sample.if_utilization = sim.getIFUtilization();
+    sample.id_utilization = sim.getIDUtilization();
+    sample.ex_utilization = sim.getEXUtilization();
+    sample.mem_utilization = sim.getMEMUtilization();
+    sample.wb_utilization = sim.getWBUtilization();
+    sample.hazardStallCycles = sim.getHazardStallCycles();
+    sample.memoryStallCycles = sim.getMemoryStallCycles();
+    sample.flushedInstructions = sim.getFlushedInstructions();
+    sample.hostNanoseconds = hostNanoseconds();
+
+    // Instructions per microsecond; stepping backwards counts as zero.
+    uint64_t elapsed = sample.hostNanoseconds - lastNanoseconds;
+    uint64_t retired = sample.instructionsCompleted > lastInstructions ? sample.instructionsCompleted - lastInstructions : 0;
+    sample.hostMips = elapsed ? 1000.0 * retired / elapsed : 0.0;
+    lastInstructions = sample.instructionsCompleted;
+    lastNanoseconds = sample.hostNanoseconds;
+
+    uint32_t index = segment->published.load(memory_order_relaxed);
+    MetricsSegment::Slot &slot = segment->slots[index % MetricsSegment::SLOTS];
+    uint32_t sequence = slot.sequence.load(memory_order_relaxed);
+    slot.sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.index = index;
+    memcpy(&slot.sample, &sample, sizeof(sample));
+    slot.sequence.store(sequence + 2, memory_order_release);
+    segment->published.store(index + 1, memory_order_release);
+}
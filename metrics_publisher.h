@@ -0,0 +1,37 @@
+#ifndef METRICS_PUBLISHER_H
+#define METRICS_PUBLISHER_H
+
+#include <cstdint>
+#include <string>
+
+#include "metrics_segment.h"
+#include "sim_observer.h"
+
+// Publishes the counters into a POSIX shared-memory segment (e.g.
+// "/riscv-sim"). Install it with RISCVSimulator::setSampler() so it runs every
+// interval cycles; publish() can also be called directly, for example once
+// more when the program completes. The segment is removed by close().
+class MetricsPublisher : public SimObserver
+{
+public:
+    MetricsPublisher();
+    ~MetricsPublisher();
+
+    bool open(const std::string &name, int interval);
+    void close();
+    bool isOpen() const { return segment != nullptr; }
+
+    void publish(const RISCVSimulator &sim);
+    void onCycleEnd(const RISCVSimulator &sim) { publish(sim); }
+
+private:
+    MetricsSegment *segment;
+    std::string name;
+    uint64_t lastInstructions;
+    uint64_t lastNanoseconds;
+
+    MetricsPublisher(const MetricsPublisher &);
+    MetricsPublisher &operator=(const MetricsPublisher &);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "metrics_segment.h"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Publisher and reader may be separate processes, so the sequence counters
+// must not fall back to a lock inside the segment.
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "metrics segment needs lock-free 32-bit atomics");
+
+bool MetricsReader::open(const string &name)
+{
+    close();
+#ifndef _WIN32
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    void *addr = mmap(nullptr, sizeof(MetricsSegment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    segment = static_cast<const MetricsSegment *>(addr);
+    atomic_thread_fence(memory_order_acquire);
+    if (segment->magic != MetricsSegment::MAGIC || segment->version != MetricsSegment::VERSION)
+    {
+        close();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MetricsReader::close()
+{
+#ifndef _WIN32
+    if (segment)
+        munmap(const_cast<MetricsSegment *>(segment), sizeof(MetricsSegment));
+#endif
+    segment = nullptr;
+}
+
+bool MetricsReader::read(uint32_t index, MetricsSample &sample) const
+{
+    const MetricsSegment::Slot &slot = segment->slots[index % MetricsSegment::SLOTS];
+    for (;;)
+    {
+        uint32_t published = getPublished();
+        if (index >= published || published - index > (uint32_t)MetricsSegment::SLOTS)
+            return false;
+
+        uint32_t before = slot.sequence.load(memory_order_acquire);
+        uint32_t held = slot.index;
+        memcpy(&sample, &slot.sample, sizeof(sample));
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t after = slot.sequence.load(memory_order_relaxed);
+
+        if (before == after && !(before & 1))
+            return held == index;
+    }
+}
+
+bool MetricsReader::readLatest(MetricsSample &sample) const
+{
+    for (;;)
+    {
+        uint32_t published = getPublished();
+        if (published == 0)
+            return false;
+        if (read(published - 1, sample))
+            return true;
+    }
+}
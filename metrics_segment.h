@@ -0,0 +1,81 @@
+#ifndef METRICS_SEGMENT_H
+#define METRICS_SEGMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifndef RISCV_METRICS_SLOTS
+#define RISCV_METRICS_SLOTS 64
+#endif
+
+// One published snapshot of the simulator's counters. hostNanoseconds is the
+// publisher's monotonic clock and hostMips the retire rate since the previous
+// sample, both measured on the simulation thread.
+struct MetricsSample
+{
+    uint64_t totalCycles;
+    uint64_t instructionsCompleted;
+    uint64_t if_utilization, id_utilization, ex_utilization, mem_utilization, wb_utilization;
+    uint64_t hazardStallCycles;
+    uint64_t memoryStallCycles;
+    uint64_t flushedInstructions;
+    uint64_t hostNanoseconds;
+    double hostMips;
+};
+
+// Layout of the shared-memory segment: a ring of the last SLOTS samples, each
+// behind its own sequence lock. The simulator is the only writer and never
+// waits; a reader copies a slot and retries if its sequence was odd or changed
+// during the copy. published counts the samples written so far, and sample n
+// lives in slots[n % SLOTS] until it is overwritten.
+struct MetricsSegment
+{
+    static const uint32_t MAGIC = 0x544D5652; // "RVMT"
+    static const uint32_t VERSION = 1;
+    static const int SLOTS = RISCV_METRICS_SLOTS;
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        uint32_t index;
+        MetricsSample sample;
+    };
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pid;
+    uint32_t interval;
+    std::atomic<uint32_t> published;
+    Slot slots[SLOTS];
+};
+
+// Read-only view of a segment created by a MetricsPublisher, possibly in
+// another process. Reading never blocks the publisher.
+class MetricsReader
+{
+public:
+    MetricsReader() : segment(nullptr) {}
+    ~MetricsReader() { close(); }
+
+    bool open(const std::string &name);
+    void close();
+    bool isOpen() const { return segment != nullptr; }
+
+    uint32_t getPid() const { return segment->pid; }
+    uint32_t getInterval() const { return segment->interval; }
+    uint32_t getPublished() const { return segment->published.load(std::memory_order_acquire); }
+
+    // Copies sample number index. Returns false if it has not been published
+    // yet or has already been overwritten.
+    bool read(uint32_t index, MetricsSample &sample) const;
+    bool readLatest(MetricsSample &sample) const;
+
+private:
+    const MetricsSegment *segment;
+
+    MetricsReader(const MetricsReader &);
+    MetricsReader &operator=(const MetricsReader &);
+};
+
+#endif
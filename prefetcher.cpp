@@ -0,0 +1,294 @@
+#include "prefetcher.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static int clampDegree(int degree)
+{
+    if (degree < 1)
+        return 1;
+    return degree > MAX_PREFETCH_DEGREE ? MAX_PREFETCH_DEGREE : degree;
+}
+
+NextLinePrefetcher::NextLinePrefetcher(int degree, int distance)
+    : degree(clampDegree(degree)), distance(distance < 1 ? 1 : distance)
+{
+    reset();
+}
+
+void NextLinePrefetcher::reset()
+{
+    memset(&state, 0, sizeof(state));
+}
+
+void NextLinePrefetcher::onAccess(uint32_t /*pc*/, uint32_t address, bool /*miss*/, vector<uint32_t> &prefetches)
+{
+    uint32_t line = address / PREFETCH_LINE_BYTES;
+    if (state.valid && line == state.lastLine)
+        return;
+    state.lastLine = line;
+    state.valid = true;
+
+    for (int i = 0; i < degree; i++)
+        prefetches.push_back((line + distance + i) * PREFETCH_LINE_BYTES);
+}
+
+StridePrefetcher::StridePrefetcher(int degree, int distance)
+    : degree(clampDegree(degree)), distance(distance < 1 ? 1 : distance)
+{
+    reset();
+}
+
+void StridePrefetcher::reset()
+{
+    memset(&state, 0, sizeof(state));
+}
+
+void StridePrefetcher::onAccess(uint32_t pc, uint32_t address, bool /*miss*/, vector<uint32_t> &prefetches)
+{
+    Entry &entry = state.table[(pc / 2) % TABLE_SIZE];
+    if (!entry.valid || entry.pc != pc)
+    {
+        entry.pc = pc;
+        entry.lastAddress = address;
+        entry.stride = 0;
+        entry.confidence = 0;
+        entry.valid = true;
+        return;
+    }
+
+    int32_t stride = (int32_t)(address - entry.lastAddress);
+    entry.lastAddress = address;
+    if (stride == entry.stride && stride != 0)
+    {
+        if (entry.confidence < 3)
+            entry.confidence++;
+    }
+    else if (entry.confidence > 0)
+    {
+        entry.confidence--;
+    }
+    else
+    {
+        entry.stride = stride;
+    }
+
+    if (entry.confidence < 2)
+        return;
+
+    int32_t step = entry.stride;
+    if (step > 0 && step < (int32_t)PREFETCH_LINE_BYTES)
+        step = PREFETCH_LINE_BYTES;
+    else if (step < 0 && -step < (int32_t)PREFETCH_LINE_BYTES)
+        step = -(int32_t)PREFETCH_LINE_BYTES;
+
+    for (int i = 0; i < degree; i++)
+        prefetches.push_back(address + step * (distance + i));
+}
+
+StreamPrefetcher::StreamPrefetcher(int degree, int distance)
+    : degree(clampDegree(degree)), distance(distance < 1 ? 1 : distance)
+{
+    reset();
+}
+
+void StreamPrefetcher::reset()
+{
+    memset(&state, 0, sizeof(state));
+}
+
+void StreamPrefetcher::onAccess(uint32_t /*pc*/, uint32_t address, bool /*miss*/, vector<uint32_t> &prefetches)
+{
+    uint32_t line = address / PREFETCH_LINE_BYTES;
+    state.clock++;
+
+    for (int s = 0; s < STREAMS; s++)
+    {
+        Stream &stream = state.streams[s];
+        int32_t delta = (int32_t)(line - stream.lastLine);
+        if (!stream.valid || delta < -WINDOW || delta > WINDOW)
+            continue;
+
+        stream.lastUse = state.clock;
+        if (delta == 0)
+            return;
+
+        int8_t direction = delta > 0 ? 1 : -1;
+        if (direction == stream.direction)
+        {
+            if (stream.confidence < 3)
+                stream.confidence++;
+        }
+        else
+        {
+            stream.direction = direction;
+            stream.confidence = 1;
+        }
+        stream.lastLine = line;
+
+        if (stream.confidence >= 2)
+        {
+            for (int i = 0; i < degree; i++)
+                prefetches.push_back((line + direction * (distance + i)) * PREFETCH_LINE_BYTES);
+        }
+        return;
+    }
+
+    int victim = 0;
+    for (int s = 0; s < STREAMS; s++)
+    {
+        if (!state.streams[s].valid)
+        {
+            victim = s;
+            break;
+        }
+        if (state.streams[s].lastUse < state.streams[victim].lastUse)
+            victim = s;
+    }
+    Stream &stream = state.streams[victim];
+    stream.lastLine = line;
+    stream.lastUse = state.clock;
+    stream.direction = 0;
+    stream.confidence = 0;
+    stream.valid = true;
+}
+
+Prefetcher *createPrefetcher(const string &spec)
+{
+    size_t comma = spec.find(',');
+    string name = spec.substr(0, comma);
+    int degree = 1;
+    int distance = 1;
+
+    while (comma != string::npos)
+    {
+        size_t begin = comma + 1;
+        comma = spec.find(',', begin);
+        string item = spec.substr(begin, comma == string::npos ? string::npos : comma - begin);
+
+        size_t equals = item.find('=');
+        if (equals == string::npos)
+            return NULL;
+        string key = item.substr(0, equals);
+        string value = item.substr(equals + 1);
+
+        char *rest;
+        long number = strtol(value.c_str(), &rest, 10);
+        if (value.empty() || *rest != '\0' || number < 1)
+            return NULL;
+        if (key == "degree")
+            degree = number;
+        else if (key == "distance")
+            distance = number;
+        else
+            return NULL;
+    }
+
+    if (name == "next-line")
+        return new NextLinePrefetcher(degree, distance);
+    if (name == "stride")
+        return new StridePrefetcher(degree, distance);
+    if (name == "stream")
+        return new StreamPrefetcher(degree, distance);
+    return NULL;
+}
+
+void PrefetchBuffer::reset()
+{
+    memset(lines, 0, sizeof(lines));
+    clock = 0;
+    queued = 0;
+    issued = useful = hits = lateHits = misses = dropped = 0;
+}
+
+// Records the arrival cycle of entries whose DRAM request has issued and
+// gives their queue slots back.
+void PrefetchBuffer::update(DramModel &dram)
+{
+    if (queued == 0)
+        return;
+    for (int i = 0; i < LINES; i++)
+    {
+        Line &entry = lines[i];
+        if (entry.valid && entry.slot >= 0 && dram.completion(entry.slot) != DramModel::PENDING)
+        {
+            entry.ready = dram.completion(entry.slot);
+            dram.release(entry.slot);
+            entry.slot = -1;
+            queued--;
+        }
+    }
+}
+
+void PrefetchBuffer::prefetch(uint32_t address, uint64_t now, DramModel &dram)
+{
+    uint32_t line = address / PREFETCH_LINE_BYTES;
+    int victim = -1;
+    for (int i = 0; i < LINES; i++)
+    {
+        if (lines[i].valid && lines[i].line == line)
+            return;
+        if (victim >= 0 && !lines[victim].valid)
+            continue;
+        if (victim < 0 || !lines[i].valid || lines[i].lastUse < lines[victim].lastUse)
+            victim = i;
+    }
+
+    if (dram.getFreeSlots() <= RESERVED_SLOTS)
+    {
+        dropped++;
+        return;
+    }
+
+    Line &entry = lines[victim];
+    if (entry.valid && entry.slot >= 0)
+    {
+        // Replaced before it issued: cancel the request.
+        dram.release(entry.slot);
+        queued--;
+    }
+
+    entry.line = line;
+    entry.ready = DramModel::PENDING;
+    entry.lastUse = ++clock;
+    entry.slot = dram.request(line * PREFETCH_LINE_BYTES, now);
+    entry.valid = true;
+    entry.used = false;
+    queued++;
+    issued++;
+}
+
+int PrefetchBuffer::lookup(uint32_t address, uint64_t now, DramModel &dram)
+{
+    update(dram);
+
+    uint32_t line = address / PREFETCH_LINE_BYTES;
+    for (int i = 0; i < LINES; i++)
+    {
+        Line &entry = lines[i];
+        if (!entry.valid || entry.line != line)
+            continue;
+
+        hits++;
+        if (!entry.used)
+        {
+            entry.used = true;
+            useful++;
+        }
+        if (entry.ready > now)
+            lateHits++;
+        entry.lastUse = ++clock;
+        return i;
+    }
+
+    misses++;
+    return -1;
+}
+
+uint64_t PrefetchBuffer::getReady(int entry, DramModel &dram)
+{
+    update(dram);
+    return lines[entry].ready;
+}
@@ -0,0 +1,212 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dram_model.h"
+
+#ifndef RISCV_PREFETCH_LINE_BYTES
+#define RISCV_PREFETCH_LINE_BYTES 32
+#endif
+
+#ifndef RISCV_PREFETCH_BUFFER_LINES
+#define RISCV_PREFETCH_BUFFER_LINES 16
+#endif
+
+const uint32_t PREFETCH_LINE_BYTES = RISCV_PREFETCH_LINE_BYTES;
+const int MAX_PREFETCH_DEGREE = RISCV_PREFETCH_BUFFER_LINES / 2;
+
+// A prefetcher watches the demand accesses of one stream (instruction fetch
+// or data) and names the lines worth fetching ahead. Addresses are DRAM
+// addresses; prefetches are line addresses. Degree is the number of lines
+// requested per trigger and distance how far ahead of the access the first
+// one is.
+//
+// All trained state lives in one plain struct exposed through getState(),
+// which the simulator saves as raw bytes for checkpoints and undo.
+class Prefetcher
+{
+public:
+    virtual ~Prefetcher() {}
+
+    virtual const char *getName() const = 0;
+    virtual void reset() = 0;
+    virtual void onAccess(uint32_t pc, uint32_t address, bool miss, std::vector<uint32_t> &prefetches) = 0;
+
+    virtual void *getState() = 0;
+    virtual size_t getStateSize() const = 0;
+};
+
+// Prefetches the lines after each new line the stream touches. Meant for
+// instruction fetch.
+class NextLinePrefetcher : public Prefetcher
+{
+public:
+    NextLinePrefetcher(int degree = 1, int distance = 1);
+
+    const char *getName() const { return "next-line"; }
+    void reset();
+    void onAccess(uint32_t pc, uint32_t address, bool miss, std::vector<uint32_t> &prefetches);
+
+    void *getState() { return &state; }
+    size_t getStateSize() const { return sizeof(state); }
+
+private:
+    struct State
+    {
+        uint32_t lastLine;
+        bool valid;
+    };
+
+    int degree;
+    int distance;
+    State state;
+};
+
+// Reference prediction table indexed by the PC of the load or store. Once an
+// instruction has repeated the same address stride twice, it prefetches
+// distance..distance+degree-1 strides ahead. Strides shorter than a line are
+// rounded up to one line so the prefetches still run ahead of the walk.
+class StridePrefetcher : public Prefetcher
+{
+public:
+    static const int TABLE_SIZE = 32;
+
+    StridePrefetcher(int degree = 1, int distance = 1);
+
+    const char *getName() const { return "stride"; }
+    void reset();
+    void onAccess(uint32_t pc, uint32_t address, bool miss, std::vector<uint32_t> &prefetches);
+
+    void *getState() { return &state; }
+    size_t getStateSize() const { return sizeof(state); }
+
+private:
+    struct Entry
+    {
+        uint32_t pc;
+        uint32_t lastAddress;
+        int32_t stride;
+        uint8_t confidence;
+        bool valid;
+    };
+    struct State
+    {
+        Entry table[TABLE_SIZE];
+    };
+
+    int degree;
+    int distance;
+    State state;
+};
+
+// Tracks up to STREAMS ascending or descending line sequences regardless of
+// PC. A stream is confirmed by two moves in the same direction within WINDOW
+// lines; each further move prefetches degree lines starting distance lines
+// ahead of it.
+class StreamPrefetcher : public Prefetcher
+{
+public:
+    static const int STREAMS = 8;
+    static const int WINDOW = 4;
+
+    StreamPrefetcher(int degree = 1, int distance = 1);
+
+    const char *getName() const { return "stream"; }
+    void reset();
+    void onAccess(uint32_t pc, uint32_t address, bool miss, std::vector<uint32_t> &prefetches);
+
+    void *getState() { return &state; }
+    size_t getStateSize() const { return sizeof(state); }
+
+private:
+    struct Stream
+    {
+        uint32_t lastLine;
+        uint32_t lastUse;
+        int8_t direction;
+        uint8_t confidence;
+        bool valid;
+    };
+    struct State
+    {
+        Stream streams[STREAMS];
+        uint32_t clock;
+    };
+
+    int degree;
+    int distance;
+    State state;
+};
+
+// Creates a prefetcher from "next-line", "stride" or "stream", optionally
+// followed by ",degree=N,distance=M". Returns NULL for a bad spec; the caller
+// owns the result.
+Prefetcher *createPrefetcher(const std::string &spec);
+
+// Lines fetched by one stream's prefetcher, held until a demand access uses
+// them or they are replaced (LRU). Entries keep their DRAM request slot only
+// until the request issues; after that their arrival cycle is known.
+//
+// Statistics: coverage is the fraction of demand accesses served from the
+// buffer, accuracy the fraction of prefetched lines used at least once, and
+// timeliness the fraction of buffer hits whose line had already arrived.
+class PrefetchBuffer
+{
+public:
+    static const int LINES = RISCV_PREFETCH_BUFFER_LINES;
+    // DRAM queue slots left for the demand requests of IF and MEM.
+    static const int RESERVED_SLOTS = 2;
+    static_assert(DramModel::QUEUE_DEPTH >= RESERVED_SLOTS, "DRAM queue too shallow for IF and MEM");
+
+    PrefetchBuffer() { reset(); }
+    void reset();
+
+    // Requests the line containing address unless it is already buffered or
+    // the DRAM queue has no room to spare.
+    void prefetch(uint32_t address, uint64_t now, DramModel &dram);
+
+    // Looks up a demand access. Returns the entry holding its line, or -1.
+    int lookup(uint32_t address, uint64_t now, DramModel &dram);
+    // Arrival cycle of an entry's line, or DramModel::PENDING while queued.
+    uint64_t getReady(int entry, DramModel &dram);
+
+    uint64_t getIssued() const { return issued; }
+    uint64_t getUseful() const { return useful; }
+    uint64_t getHits() const { return hits; }
+    uint64_t getLateHits() const { return lateHits; }
+    uint64_t getMisses() const { return misses; }
+    uint64_t getDropped() const { return dropped; }
+    double getCoverage() const { return hits + misses ? (double)hits / (hits + misses) : 0.0; }
+    double getAccuracy() const { return issued ? (double)useful / issued : 0.0; }
+    double getTimeliness() const { return hits ? (double)(hits - lateHits) / hits : 0.0; }
+
+private:
+    struct Line
+    {
+        uint32_t line;
+        uint64_t ready;
+        uint64_t lastUse;
+        int8_t slot;
+        bool valid;
+        bool used;
+    };
+
+    Line lines[LINES];
+    uint64_t clock;
+    int queued;
+
+    uint64_t issued;
+    uint64_t useful;
+    uint64_t hits;
+    uint64_t lateHits;
+    uint64_t misses;
+    uint64_t dropped;
+
+    void update(DramModel &dram);
+};
+
+#endif
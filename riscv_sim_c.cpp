@@ -0,0 +1,261 @@
+#include "riscv_sim_c.h"
+#include "riscv_simulator.h"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+struct rv_sim
+{
+    // Declared first so they outlive the simulator that points to them.
+    std::unique_ptr<Prefetcher> instructionPrefetcher;
+    std::unique_ptr<Prefetcher> dataPrefetcher;
+    RISCVSimulator simulator;
+};
+
+#define CHECK_LAYOUT(c_type, cpp_type, field) \
+    static_assert(offsetof(c_type, field) == offsetof(cpp_type, field), #c_type "." #field " layout mismatch")
+
+static_assert(sizeof(rv_if_id) == sizeof(IF_ID), "rv_if_id layout mismatch");
+static_assert(sizeof(rv_id_ex) == sizeof(ID_EX), "rv_id_ex layout mismatch");
+static_assert(sizeof(rv_ex_mem) == sizeof(EX_MEM), "rv_ex_mem layout mismatch");
+static_assert(sizeof(rv_mem_wb) == sizeof(MEM_WB), "rv_mem_wb layout mismatch");
+CHECK_LAYOUT(rv_if_id, IF_ID, PC);
+CHECK_LAYOUT(rv_if_id, IF_ID, NPC);
+CHECK_LAYOUT(rv_if_id, IF_ID, seq);
+CHECK_LAYOUT(rv_if_id, IF_ID, valid);
+CHECK_LAYOUT(rv_id_ex, ID_EX, PC);
+CHECK_LAYOUT(rv_id_ex, ID_EX, Imm);
+CHECK_LAYOUT(rv_id_ex, ID_EX, seq);
+CHECK_LAYOUT(rv_id_ex, ID_EX, valid);
+CHECK_LAYOUT(rv_ex_mem, EX_MEM, PC);
+CHECK_LAYOUT(rv_ex_mem, EX_MEM, cond);
+CHECK_LAYOUT(rv_ex_mem, EX_MEM, seq);
+CHECK_LAYOUT(rv_ex_mem, EX_MEM, valid);
+CHECK_LAYOUT(rv_mem_wb, MEM_WB, LMD);
+CHECK_LAYOUT(rv_mem_wb, MEM_WB, seq);
+CHECK_LAYOUT(rv_mem_wb, MEM_WB, valid);
+
+static_assert((int)RV_STOP_LIMIT == (int)STOP_LIMIT, "rv_stop_reason out of sync with StopReason");
+
+rv_sim *rv_sim_create(void)
+{
+    return new (std::nothrow) rv_sim;
+}
+
+void rv_sim_destroy(rv_sim *sim)
+{
+    delete sim;
+}
+
+bool rv_sim_load(rv_sim *sim, const char *filename)
+{
+    if (!sim->simulator.loadProgram(filename))
+        return false;
+    sim->simulator.reset();
+    return true;
+}
+
+void rv_sim_reset(rv_sim *sim)
+{
+    sim->simulator.reset();
+}
+
+int rv_sim_step(rv_sim *sim, int cycles)
+{
+    return sim->simulator.step(cycles);
+}
+
+int rv_sim_run_until_pc(rv_sim *sim, uint32_t pc, int max_cycles)
+{
+    return sim->simulator.runUntil([pc](const RISCVSimulator &s)
+                                   { return s.getPC() == pc; },
+                                   max_cycles);
+}
+
+int rv_sim_run_until(rv_sim *sim, rv_sim_condition done, void *user, int max_cycles)
+{
+    return sim->simulator.runUntil([sim, done, user](const RISCVSimulator &)
+                                   { return done(sim, user); },
+                                   max_cycles);
+}
+
+void rv_sim_add_breakpoint(rv_sim *sim, uint32_t pc)
+{
+    sim->simulator.addBreakpoint(pc);
+}
+
+void rv_sim_remove_breakpoint(rv_sim *sim, uint32_t pc)
+{
+    sim->simulator.removeBreakpoint(pc);
+}
+
+void rv_sim_add_watchpoint(rv_sim *sim, uint32_t address)
+{
+    sim->simulator.addWatchpoint(address);
+}
+
+void rv_sim_remove_watchpoint(rv_sim *sim, uint32_t address)
+{
+    sim->simulator.removeWatchpoint(address);
+}
+
+rv_stop_reason rv_sim_run_until_stop(rv_sim *sim, int max_cycles)
+{
+    return (rv_stop_reason)sim->simulator.runUntilStop(max_cycles);
+}
+
+uint32_t rv_sim_stop_address(const rv_sim *sim)
+{
+    return sim->simulator.getStopAddress();
+}
+
+void rv_sim_enable_history(rv_sim *sim, size_t max_cycles, int checkpoint_interval)
+{
+    sim->simulator.enableHistory(max_cycles, checkpoint_interval);
+}
+
+bool rv_sim_reverse_cycle(rv_sim *sim)
+{
+    return sim->simulator.reverseCycle();
+}
+
+bool rv_sim_reverse_instruction(rv_sim *sim)
+{
+    return sim->simulator.reverseInstruction();
+}
+
+rv_stop_reason rv_sim_reverse_continue(rv_sim *sim)
+{
+    return (rv_stop_reason)sim->simulator.reverseContinue();
+}
+
+bool rv_sim_is_complete(const rv_sim *sim)
+{
+    return sim->simulator.isProgramComplete();
+}
+
+bool rv_sim_exited(const rv_sim *sim)
+{
+    return sim->simulator.hasExited();
+}
+
+int32_t rv_sim_exit_code(const rv_sim *sim)
+{
+    return sim->simulator.getExitCode();
+}
+
+bool rv_sim_faulted(const rv_sim *sim)
+{
+    return sim->simulator.hasFaulted();
+}
+
+uint32_t rv_sim_fault_pc(const rv_sim *sim)
+{
+    return sim->simulator.getFaultPC();
+}
+
+void rv_sim_flush_output(rv_sim *sim)
+{
+    sim->simulator.flushOutput();
+}
+
+bool rv_sim_configure_dram(rv_sim *sim, const char *spec)
+{
+    if (spec == NULL)
+    {
+        sim->simulator.disableDram();
+        return true;
+    }
+    DramConfig config;
+    return parseDramConfig(spec, config) && sim->simulator.configureDram(config);
+}
+
+bool rv_sim_set_instruction_prefetcher(rv_sim *sim, const char *spec)
+{
+    Prefetcher *prefetcher = spec ? createPrefetcher(spec) : NULL;
+    if (spec && !prefetcher)
+        return false;
+    sim->simulator.setInstructionPrefetcher(prefetcher);
+    sim->instructionPrefetcher.reset(prefetcher);
+    return true;
+}
+
+bool rv_sim_set_data_prefetcher(rv_sim *sim, const char *spec)
+{
+    Prefetcher *prefetcher = spec ? createPrefetcher(spec) : NULL;
+    if (spec && !prefetcher)
+        return false;
+    sim->simulator.setDataPrefetcher(prefetcher);
+    sim->dataPrefetcher.reset(prefetcher);
+    return true;
+}
+
+int64_t rv_sim_cycles(const rv_sim *sim)
+{
+    return sim->simulator.getTotalCycles();
+}
+
+int64_t rv_sim_instructions(const rv_sim *sim)
+{
+    return sim->simulator.getInstructionsCompleted();
+}
+
+uint32_t rv_sim_pc(const rv_sim *sim)
+{
+    return sim->simulator.getPC();
+}
+
+const int32_t *rv_sim_registers(const rv_sim *sim)
+{
+    return sim->simulator.getRegisters().data();
+}
+
+const uint32_t *rv_sim_instruction_memory(const rv_sim *sim, size_t *words)
+{
+    Span<uint32_t> memory = sim->simulator.getInstructionMemory();
+    if (words)
+        *words = memory.size();
+    return memory.data();
+}
+
+const int32_t *rv_sim_data_memory(const rv_sim *sim, size_t *words)
+{
+    Span<int32_t> memory = sim->simulator.getDataMemory();
+    if (words)
+        *words = memory.size();
+    return memory.data();
+}
+
+const int32_t *rv_sim_data_page(const rv_sim *sim, size_t page, size_t *words)
+{
+    Span<int32_t> memory = sim->simulator.getDataPage(page);
+    if (words)
+        *words = memory.size();
+    return memory.data();
+}
+
+size_t rv_sim_data_page_count(const rv_sim *sim)
+{
+    return sim->simulator.getDataPageCount();
+}
+
+const rv_if_id *rv_sim_if_id(const rv_sim *sim)
+{
+    return reinterpret_cast<const rv_if_id *>(&sim->simulator.getIFID());
+}
+
+const rv_id_ex *rv_sim_id_ex(const rv_sim *sim)
+{
+    return reinterpret_cast<const rv_id_ex *>(&sim->simulator.getIDEX());
+}
+
+const rv_ex_mem *rv_sim_ex_mem(const rv_sim *sim)
+{
+    return reinterpret_cast<const rv_ex_mem *>(&sim->simulator.getEXMEM());
+}
+
+const rv_mem_wb *rv_sim_mem_wb(const rv_sim *sim)
+{
+    return reinterpret_cast<const rv_mem_wb *>(&sim->simulator.getMEMWB());
+}
@@ -0,0 +1,148 @@
+#ifndef RISCV_SIM_C_H
+#define RISCV_SIM_C_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Opaque handle to one simulator instance. */
+typedef struct rv_sim rv_sim;
+
+/* Pipeline latches, laid out exactly like the C++ IF_ID/ID_EX/EX_MEM/MEM_WB
+   classes so the accessors below can return pointers into the simulator. */
+typedef struct
+{
+    uint32_t IR;
+    uint32_t PC;
+    uint32_t NPC;
+    uint64_t seq;
+    bool valid;
+} rv_if_id;
+
+typedef struct
+{
+    uint32_t IR;
+    uint32_t PC;
+    uint32_t NPC;
+    int32_t A;
+    int32_t B;
+    int32_t Imm;
+    uint64_t seq;
+    bool valid;
+} rv_id_ex;
+
+typedef struct
+{
+    uint32_t IR;
+    uint32_t PC;
+    int32_t B;
+    int32_t ALUOutput;
+    bool cond;
+    uint64_t seq;
+    bool valid;
+} rv_ex_mem;
+
+typedef struct
+{
+    uint32_t IR;
+    int32_t ALUOutput;
+    int32_t LMD;
+    uint64_t seq;
+    bool valid;
+} rv_mem_wb;
+
+/* Same values as the C++ StopReason enum. */
+typedef enum
+{
+    RV_STOP_NONE,
+    RV_STOP_COMPLETE,
+    RV_STOP_BREAKPOINT,
+    RV_STOP_WATCHPOINT,
+    RV_STOP_REGISTER,
+    RV_STOP_CYCLES,
+    RV_STOP_INSTRUCTIONS,
+    RV_STOP_ILLEGAL,
+    RV_STOP_LIMIT
+} rv_stop_reason;
+
+typedef bool (*rv_sim_condition)(const rv_sim *sim, void *user);
+
+rv_sim *rv_sim_create(void);
+void rv_sim_destroy(rv_sim *sim);
+
+/* Loads a .hex or .rvb program and resets the pipeline. Returns false on error. */
+bool rv_sim_load(rv_sim *sim, const char *filename);
+void rv_sim_reset(rv_sim *sim);
+
+/* Each returns the number of cycles actually executed. */
+int rv_sim_step(rv_sim *sim, int cycles);
+int rv_sim_run_until_pc(rv_sim *sim, uint32_t pc, int max_cycles);
+int rv_sim_run_until(rv_sim *sim, rv_sim_condition done, void *user, int max_cycles);
+
+/* Breakpoints fire when the instruction at pc issues; watchpoints on stores
+   to the word containing address. */
+void rv_sim_add_breakpoint(rv_sim *sim, uint32_t pc);
+void rv_sim_remove_breakpoint(rv_sim *sim, uint32_t pc);
+void rv_sim_add_watchpoint(rv_sim *sim, uint32_t address);
+void rv_sim_remove_watchpoint(rv_sim *sim, uint32_t address);
+rv_stop_reason rv_sim_run_until_stop(rv_sim *sim, int max_cycles);
+uint32_t rv_sim_stop_address(const rv_sim *sim);
+
+/* Reverse execution. History must be enabled first; it records an undo
+   journal of at most max_cycles cycles plus a checkpoint every
+   checkpoint_interval cycles (at least 1). The reverse calls return false (or
+   RV_STOP_LIMIT) at the start of the recorded history. */
+void rv_sim_enable_history(rv_sim *sim, size_t max_cycles, int checkpoint_interval);
+bool rv_sim_reverse_cycle(rv_sim *sim);
+bool rv_sim_reverse_instruction(rv_sim *sim);
+rv_stop_reason rv_sim_reverse_continue(rv_sim *sim);
+
+bool rv_sim_is_complete(const rv_sim *sim);
+/* True once the program has made the exit system call. */
+bool rv_sim_exited(const rv_sim *sim);
+int32_t rv_sim_exit_code(const rv_sim *sim);
+/* True once an instruction the simulator cannot decode has reached MEM. */
+bool rv_sim_faulted(const rv_sim *sim);
+uint32_t rv_sim_fault_pc(const rv_sim *sim);
+/* Writes out guest output still held in the simulator's buffer. */
+void rv_sim_flush_output(rv_sim *sim);
+
+/* Enables DRAM timing with a spec such as "channels=2,banks=8,row=2048,
+   trcd=14,tcas=14,trp=14,burst=4,policy=closed" (omitted keys keep their
+   defaults), or disables it when spec is NULL. Returns false on a bad spec. */
+bool rv_sim_configure_dram(rv_sim *sim, const char *spec);
+
+/* Installs a prefetcher ("next-line", "stride" or "stream", optionally with
+   ",degree=N,distance=M") for instruction fetch or data accesses, or removes
+   it when spec is NULL. Prefetchers only run with DRAM timing enabled.
+   Returns false on a bad spec. */
+bool rv_sim_set_instruction_prefetcher(rv_sim *sim, const char *spec);
+bool rv_sim_set_data_prefetcher(rv_sim *sim, const char *spec);
+int64_t rv_sim_cycles(const rv_sim *sim);
+int64_t rv_sim_instructions(const rv_sim *sim);
+uint32_t rv_sim_pc(const rv_sim *sim);
+
+/* Pointers into simulator state. They stay valid until the next rv_sim_load;
+   data memory pointers also move once, when the program's first brk grows
+   data memory. */
+const int32_t *rv_sim_registers(const rv_sim *sim);
+const uint32_t *rv_sim_instruction_memory(const rv_sim *sim, size_t *words);
+const int32_t *rv_sim_data_memory(const rv_sim *sim, size_t *words);
+const int32_t *rv_sim_data_page(const rv_sim *sim, size_t page, size_t *words);
+size_t rv_sim_data_page_count(const rv_sim *sim);
+
+const rv_if_id *rv_sim_if_id(const rv_sim *sim);
+const rv_id_ex *rv_sim_id_ex(const rv_sim *sim);
+const rv_ex_mem *rv_sim_ex_mem(const rv_sim *sim);
+const rv_mem_wb *rv_sim_mem_wb(const rv_sim *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
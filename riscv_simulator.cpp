@@ -0,0 +1,1938 @@
+#include "riscv_simulator.h"
+#include "syscall_emulation.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef RISCV_SIM_NO_OBSERVERS
+#define NOTIFY(call) \
+    do               \
+    {                \
+    } while (0)
+#else
+#define NOTIFY(call)                                  \
+    do                                                \
+    {                                                 \
+        for (size_t i = 0; i < observers.size(); i++) \
+            observers[i]->call;                       \
+    } while (0)
+#endif
+
+// Instruction and data memory are separate arrays, so DRAM sees instruction
+// fetches at this offset to keep them out of the data rows.
+const uint32_t DRAM_TEXT_BASE = 0x80000000;
+
+// Binary program image (.rvb): a header, a section table and the raw section
+// payloads, all little-endian. Sections are copied straight into instruction
+// or data memory at their load address, so loading needs no parsing.
+const uint32_t IMAGE_MAGIC = 0x4D495652; // "RVIM"
+const uint16_t IMAGE_VERSION = 1;
+// Sections must end within this many bytes of their memory.
+const uint64_t MAX_IMAGE_SECTION_END = 64 * 1024 * 1024;
+
+enum ImageSectionType
+{
+    SECTION_TEXT = 0,
+    SECTION_DATA = 1
+};
+
+struct ImageHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sectionCount;
+    uint32_t entryPC;
+    uint32_t reserved;
+};
+
+struct ImageSection
+{
+    uint32_t type;
+    uint32_t loadAddress;
+    uint32_t size;
+    uint32_t offset;
+};
+
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0), mapped(false) {}
+    ~MappedFile() { close(); }
+
+    bool open(const string &filename);
+    void close();
+
+    const char *data;
+    size_t size;
+
+private:
+    bool mapped;
+    vector<char> buffer;
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+bool MappedFile::open(const string &filename)
+{
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size = st.st_size;
+    if (size > 0)
+    {
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            data = static_cast<const char *>(addr);
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if (mapped || size == 0)
+        return true;
+#endif
+
+    ifstream file(filename, ios::binary);
+    if (!file.is_open())
+        return false;
+    buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<char *>(data), size);
+#endif
+    mapped = false;
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+}
+
+// SWAR helpers: test and convert eight ASCII hex digits held in one 64-bit word.
+static inline bool isHexDigit(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static inline uint64_t bytesInRange(uint64_t v, uint8_t lo, uint8_t hi)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t aboveHi = v + ones * (0x7F - hi);
+    uint64_t atLeastLo = v + ones * (0x80 - lo);
+    return atLeastLo & ~aboveHi & (ones * 0x80);
+}
+
+static inline bool isHex8(uint64_t v)
+{
+    const uint64_t high = 0x8080808080808080ULL;
+    if (v & high)
+        return false;
+    uint64_t digits = bytesInRange(v, '0', '9');
+    uint64_t letters = bytesInRange(v | 0x2020202020202020ULL, 'a', 'f');
+    return (digits | letters) == high;
+}
+
+static inline uint32_t parseHex8(uint64_t v)
+{
+    uint64_t letters = (v & 0x4040404040404040ULL) >> 6;
+    v = (v & 0x0F0F0F0F0F0F0F0FULL) + letters * 9;
+    v = ((v & 0x000F000F000F000FULL) << 4) | ((v >> 8) & 0x000F000F000F000FULL);
+    v = ((v & 0x000000FF000000FFULL) << 8) | ((v >> 16) & 0x000000FF000000FFULL);
+    return (uint32_t)(((v & 0xFFFF) << 16) | ((v >> 32) & 0xFFFF));
+}
+
+// Parses one line of a .hex file. Returns false for blank and comment lines.
+static bool parseHexLine(const char *p, const char *end, uint32_t &word)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (p == end || *p == '#')
+        return false;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+
+    if (end - p >= 8)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        if (isHex8(chunk))
+        {
+            // Spaces join digit groups, so eight digits are the whole word
+            // unless another digit follows them.
+            const char *rest = p + 8;
+            while (rest < end && *rest == ' ')
+                rest++;
+            if (rest == end || !isHexDigit(*rest))
+            {
+                word = parseHex8(chunk);
+                return true;
+            }
+        }
+    }
+
+    uint32_t value = 0;
+    bool found = false;
+    for (; p < end; p++)
+    {
+        char c = *p;
+        if (c == ' ')
+            continue;
+        if (!isHexDigit(c))
+            break;
+        value = (value << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        found = true;
+    }
+    word = value;
+    return found;
+}
+
+
+RISCVSimulator::RISCVSimulator()
+{
+    instructionMemory.resize(512, 0);
+    dataMemory.resize(512, 0);
+    entryPC = 0;
+    initialBreak = dataMemory.size() * 4;
+    instructionPrefetcher = dataPrefetcher = NULL;
+    sampler = NULL;
+    samplerInterval = samplerCycle = 0;
+    setSyscallStreams(stdin, stdout, stderr);
+    clearConditions();
+    reset();
+}
+
+RISCVSimulator::~RISCVSimulator()
+{
+    flushOutput();
+}
+
+void RISCVSimulator::reset()
+{
+    for (int i = 0; i < 32; i++)
+    {
+        registers[i] = 0;
+    }
+    PC = entryPC;
+    totalCycles = 0;
+    if_utilization = id_utilization = ex_utilization = mem_utilization = wb_utilization = 0;
+    stall = false;
+    branch_taken = false;
+    squash_if_id = false;
+    flushed = false;
+    instructionsCompleted = 0;
+    hazardStallCycles = flushedInstructions = 0;
+    nextSeq = 0;
+    fetchBuffer = FetchBuffer();
+    fetchLength = 4;
+    fetchBlockReads = fetchedInstructions = fetchedCompressed = 0;
+    dram.reset();
+    fetchRequest = memoryRequest = fetchLine = memoryLine = -1;
+    memoryReady = 0;
+    memoryStallCycles = 0;
+    instructionPrefetches.reset();
+    dataPrefetches.reset();
+    if (instructionPrefetcher)
+        instructionPrefetcher->reset();
+    if (dataPrefetcher)
+        dataPrefetcher->reset();
+    stopReason = STOP_NONE;
+    stopAddress = 0;
+
+    trapPending = false;
+    exited = false;
+    exitCode = 0;
+    faulted = false;
+    faultPC = 0;
+    programBreak = initialBreak;
+    inputOffset = outputOffset = outputEmitted = 0;
+    inputHistory.clear();
+    outputBuffer.clear();
+    outputFd = 1;
+
+    if_id = IF_ID();
+    id_ex = ID_EX();
+    ex_mem = EX_MEM();
+    mem_wb = MEM_WB();
+
+    restartHistory();
+}
+
+bool RISCVSimulator::loadProgram(const string &filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        cerr << "Error: Could not open file " << filename << endl;
+        return false;
+    }
+
+    uint32_t magic = 0;
+    if (file.size >= sizeof(magic))
+        memcpy(&magic, file.data, sizeof(magic));
+
+    bool loaded = (magic == IMAGE_MAGIC) ? loadImage(file, filename) : loadHex(file);
+    if (!loaded)
+        return false;
+
+    initialBreak = dataMemory.size() * 4;
+    measureCode();
+    reset();
+    return true;
+}
+
+// Counts the 16- and 32-bit instructions in instruction memory for the
+// code density statistics. Zero parcels are padding.
+void RISCVSimulator::measureCode()
+{
+    staticInstructions = staticCompressed = 0;
+    size_t bytes = instructionMemory.size() * 4;
+    for (uint32_t pc = 0; pc < bytes;)
+    {
+        uint16_t parcel = readParcel(instructionMemory.data(), instructionMemory.size(), pc);
+        if (parcel == 0)
+        {
+            pc += 2;
+            continue;
+        }
+        staticInstructions++;
+        if (isCompressed(parcel))
+        {
+            staticCompressed++;
+            pc += 2;
+        }
+        else
+        {
+            pc += 4;
+        }
+    }
+}
+
+bool RISCVSimulator::loadHex(const MappedFile &file)
+{
+    vector<uint32_t> words;
+    const char *p = file.data;
+    const char *end = file.data + file.size;
+
+    while (p < end)
+    {
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+
+        uint32_t word;
+        if (parseHexLine(p, lineEnd, word))
+            words.push_back(word);
+
+        p = lineEnd + 1;
+    }
+
+    instructionMemory.assign(max<size_t>(512, words.size()), 0);
+    if (!words.empty())
+        memcpy(instructionMemory.data(), words.data(), words.size() * sizeof(uint32_t));
+    dataMemory.assign(512, 0);
+    entryPC = 0;
+    return true;
+}
+
+bool RISCVSimulator::loadImage(const MappedFile &file, const string &filename)
+{
+    ImageHeader header;
+    if (file.size < sizeof(header))
+    {
+        cerr << "Error: Truncated program image " << filename << endl;
+        return false;
+    }
+    memcpy(&header, file.data, sizeof(header));
+
+    if (header.version != IMAGE_VERSION ||
+        file.size < sizeof(header) + (size_t)header.sectionCount * sizeof(ImageSection))
+    {
+        cerr << "Error: Unsupported program image " << filename << endl;
+        return false;
+    }
+
+    // Everything is checked before memory is touched, so a bad image leaves
+    // the loaded program as it was.
+    const char *table = file.data + sizeof(header);
+    size_t textWords = 512, dataWords = 512;
+    for (int i = 0; i < header.sectionCount; i++)
+    {
+        ImageSection section;
+        memcpy(&section, table + i * sizeof(ImageSection), sizeof(section));
+
+        uint64_t end = (uint64_t)section.loadAddress + section.size;
+        if ((uint64_t)section.offset + section.size > file.size || section.loadAddress % 4 != 0 ||
+            end > MAX_IMAGE_SECTION_END || (section.type != SECTION_TEXT && section.type != SECTION_DATA))
+        {
+            cerr << "Error: Corrupt section " << i << " in program image " << filename << endl;
+            return false;
+        }
+        size_t &words = (section.type == SECTION_TEXT) ? textWords : dataWords;
+        words = max<size_t>(words, (end + 3) / 4);
+    }
+
+    if (header.entryPC % 2 != 0 || header.entryPC >= textWords * 4)
+    {
+        cerr << "Error: Entry PC 0x" << hex << header.entryPC << dec << " is misaligned or outside the text of "
+             << filename << endl;
+        return false;
+    }
+
+    instructionMemory.assign(textWords, 0);
+    dataMemory.assign(dataWords, 0);
+    for (int i = 0; i < header.sectionCount; i++)
+    {
+        ImageSection section;
+        memcpy(&section, table + i * sizeof(ImageSection), sizeof(section));
+        char *dest = (section.type == SECTION_TEXT) ? reinterpret_cast<char *>(instructionMemory.data())
+                                                    : reinterpret_cast<char *>(dataMemory.data());
+        memcpy(dest + section.loadAddress, file.data + section.offset, section.size);
+    }
+
+    entryPC = header.entryPC;
+    return true;
+}
+
+bool RISCVSimulator::saveImage(const string &filename)
+{
+    size_t textWords = instructionMemory.size();
+    while (textWords > 0 && instructionMemory[textWords - 1] == 0)
+        textWords--;
+    size_t dataWords = dataMemory.size();
+    while (dataWords > 0 && dataMemory[dataWords - 1] == 0)
+        dataWords--;
+
+    ImageHeader header;
+    header.magic = IMAGE_MAGIC;
+    header.version = IMAGE_VERSION;
+    header.sectionCount = dataWords > 0 ? 2 : 1;
+    header.entryPC = entryPC;
+    header.reserved = 0;
+
+    ImageSection sections[2];
+    sections[0].type = SECTION_TEXT;
+    sections[0].loadAddress = 0;
+    sections[0].size = textWords * 4;
+    sections[0].offset = sizeof(header) + header.sectionCount * sizeof(ImageSection);
+    sections[1].type = SECTION_DATA;
+    sections[1].loadAddress = 0;
+    sections[1].size = dataWords * 4;
+    sections[1].offset = sections[0].offset + sections[0].size;
+
+    ofstream file(filename, ios::binary);
+    if (!file.is_open())
+    {
+        cerr << "Error: Could not write file " << filename << endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(sections), header.sectionCount * sizeof(ImageSection));
+    file.write(reinterpret_cast<const char *>(instructionMemory.data()), sections[0].size);
+    file.write(reinterpret_cast<const char *>(dataMemory.data()), sections[1].size);
+    return file.good();
+}
+
+uint32_t RISCVSimulator::getOpcode(uint32_t instruction)
+{
+    return instruction & 0x7F;
+}
+
+uint32_t RISCVSimulator::getRd(uint32_t instruction)
+{
+    return (instruction >> 7) & 0x1F;
+}
+
+// True for the opcodes WB writes rd for; in the others bits 11:7 are not a
+// destination register.
+bool RISCVSimulator::writesRegister(uint32_t instruction)
+{
+    uint32_t opcode = getOpcode(instruction);
+    return opcode == 0x33 || opcode == 0x13 || opcode == 0x03 || opcode == 0x37 ||
+           opcode == 0x6F || opcode == 0x67;
+}
+
+uint32_t RISCVSimulator::getRs1(uint32_t instruction)
+{
+    return (instruction >> 15) & 0x1F;
+}
+
+uint32_t RISCVSimulator::getRs2(uint32_t instruction)
+{
+    return (instruction >> 20) & 0x1F;
+}
+
+uint32_t RISCVSimulator::getFunct3(uint32_t instruction)
+{
+    return (instruction >> 12) & 0x7;
+}
+
+uint32_t RISCVSimulator::getFunct7(uint32_t instruction)
+{
+    return (instruction >> 25) & 0x7F;
+}
+
+int32_t RISCVSimulator::getImmI(uint32_t instruction)
+{
+    int32_t imm = (instruction >> 20);
+    if (imm & 0x800)
+        imm |= 0xFFFFF000;
+    return imm;
+}
+
+int32_t RISCVSimulator::getImmS(uint32_t instruction)
+{
+    int32_t imm = ((instruction >> 7) & 0x1F) | ((instruction >> 20) & 0xFE0);
+    if (imm & 0x800)
+        imm |= 0xFFFFF000;
+    return imm;
+}
+
+int32_t RISCVSimulator::getImmB(uint32_t instruction)
+{
+    int32_t imm = ((instruction >> 7) & 0x1E) | ((instruction >> 20) & 0x7E0) |
+                  ((instruction << 4) & 0x800) | ((instruction >> 19) & 0x1000);
+    if (imm & 0x1000)
+        imm |= 0xFFFFE000;
+    return imm;
+}
+
+int32_t RISCVSimulator::getImmU(uint32_t instruction)
+{
+    return instruction & 0xFFFFF000;
+}
+
+int32_t RISCVSimulator::getImmJ(uint32_t instruction)
+{
+    int32_t imm = ((instruction >> 20) & 0x7FE) | ((instruction >> 9) & 0x800) |
+                  (instruction & 0xFF000) | ((instruction >> 11) & 0x100000);
+    if (imm & 0x100000)
+        imm |= 0xFFE00000;
+    return imm;
+}
+
+// True when instruction reads a register that producer will write back.
+bool RISCVSimulator::dependsOn(uint32_t instruction, uint32_t producer)
+{
+    uint32_t rs1 = getRs1(instruction);
+    uint32_t rs2 = getRs2(instruction);
+    uint32_t opcode = getOpcode(instruction);
+
+    bool uses_rs1 = (opcode != 0x37 && opcode != 0x6F);
+    bool uses_rs2 = (opcode == 0x33 || opcode == 0x23 || opcode == 0x63);
+
+    uint32_t rd = getRd(producer);
+
+    if (rd != 0 && writesRegister(producer))
+    {
+        if (uses_rs1 && rd == rs1)
+            return true;
+        if (uses_rs2 && rd == rs2)
+            return true;
+    }
+    return false;
+}
+
+bool RISCVSimulator::checkDataHazard()
+{
+    if (!if_id.valid)
+        return false;
+
+    if (id_ex.valid && dependsOn(if_id.IR, id_ex.IR))
+        return true;
+
+    if (ex_mem.valid && dependsOn(if_id.IR, ex_mem.IR))
+        return true;
+
+    return false;
+}
+
+void RISCVSimulator::IF_stage()
+{
+    if (branch_taken || trapPending)
+    {
+        if_id_next = IF_ID();
+        return;
+    }
+
+    uint32_t instruction, length;
+    int64_t blockReads = fetchBlockReads;
+    FetchResult result = fetchBuffer.fetch(instructionMemory.data(), instructionMemory.size(), PC,
+                                           instruction, length, fetchBlockReads);
+    if (dram.isEnabled() && fetchBlockReads != blockReads && result != FETCH_EMPTY)
+        accessMemory(instructionPrefetches, instructionPrefetcher, PC,
+                     DRAM_TEXT_BASE + fetchBuffer.end - FetchBuffer::BLOCK_BYTES, fetchRequest, fetchLine);
+    if (result == FETCH_OK)
+    {
+        if_id_next.IR = instruction;
+        if_id_next.PC = PC;
+        if_id_next.NPC = PC + length;
+        if_id_next.valid = true;
+        if_utilization++;
+        fetchLength = length;
+    }
+    else
+    {
+        if_id_next = IF_ID();
+        fetchLength = (result == FETCH_BUBBLE) ? 0 : 4;
+    }
+}
+
+void RISCVSimulator::ID_stage()
+{
+    if (squash_if_id)
+    {
+        if (if_id.valid)
+        {
+            flushedInstructions++;
+            flushed = true;
+            NOTIFY(onFlush(totalCycles, if_id.seq, if_id.IR));
+        }
+        id_ex_next = ID_EX();
+        squash_if_id = false;
+        return;
+    }
+
+    if (!if_id.valid)
+    {
+        id_ex_next = ID_EX();
+        return;
+    }
+
+    uint32_t opcode = getOpcode(if_id.IR);
+    uint32_t rs1 = getRs1(if_id.IR);
+    uint32_t rs2 = getRs2(if_id.IR);
+
+    if (checkDataHazard() && opcode != 0x63 && opcode != 0x6F && opcode != 0x67)
+    {
+        id_ex_next = ID_EX();
+        if_id_next = if_id;
+        stall = true;
+        hazardStallCycles++;
+        NOTIFY(onStall(totalCycles, if_id.seq, if_id.IR));
+        return;
+    }
+
+    id_ex_next.IR = if_id.IR;
+    id_ex_next.PC = if_id.PC;
+    id_ex_next.NPC = if_id.NPC;
+    id_ex_next.A = registers[rs1];
+    id_ex_next.B = registers[rs2];
+    id_ex_next.seq = if_id.seq;
+    id_ex_next.valid = true;
+    id_utilization++;
+    NOTIFY(onIssue(totalCycles, if_id.seq, if_id.IR));
+
+    if (if_id.IR == ECALL_INSTRUCTION)
+        trapPending = true;
+
+    if (isBreakpoint(if_id.PC))
+    {
+        stopReason = STOP_BREAKPOINT;
+        stopAddress = if_id.PC;
+    }
+
+    if (opcode == 0x13 || opcode == 0x03 || opcode == 0x67)
+    {
+        id_ex_next.Imm = getImmI(if_id.IR);
+    }
+    else if (opcode == 0x23)
+    {
+        id_ex_next.Imm = getImmS(if_id.IR);
+    }
+    else if (opcode == 0x63)
+    {
+        id_ex_next.Imm = getImmB(if_id.IR);
+    }
+    else if (opcode == 0x37)
+    {
+        id_ex_next.Imm = getImmU(if_id.IR);
+    }
+    else if (opcode == 0x6F)
+    {
+        id_ex_next.Imm = getImmJ(if_id.IR);
+    }
+}
+
+void RISCVSimulator::EX_stage()
+{
+    if (!id_ex.valid)
+    {
+        ex_mem_next = EX_MEM();
+        return;
+    }
+
+    uint32_t opcode = getOpcode(id_ex.IR);
+    uint32_t funct3 = getFunct3(id_ex.IR);
+    uint32_t funct7 = getFunct7(id_ex.IR);
+
+    ex_mem_next.IR = id_ex.IR;
+    ex_mem_next.PC = id_ex.PC;
+    ex_mem_next.B = id_ex.B;
+    ex_mem_next.seq = id_ex.seq;
+    ex_mem_next.valid = true;
+    ex_mem_next.cond = false;
+    ex_utilization++;
+
+    if (opcode == 0x33)
+    {
+        if (funct3 == 0x0 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = id_ex.A + id_ex.B;
+        }
+        else if (funct3 == 0x0 && funct7 == 0x20)
+        {
+            ex_mem_next.ALUOutput = id_ex.A - id_ex.B;
+        }
+        else if (funct3 == 0x0 && funct7 == 0x01)
+        {
+            int64_t result = (int64_t)id_ex.A * (int64_t)id_ex.B;
+            ex_mem_next.ALUOutput = (int32_t)(result & 0xFFFFFFFF);
+        }
+        else if (funct3 == 0x4 && funct7 == 0x01)
+        {
+            ex_mem_next.ALUOutput = (id_ex.B != 0) ? id_ex.A / id_ex.B : -1;
+        }
+        else if (funct3 == 0x6 && funct7 == 0x01)
+        {
+            ex_mem_next.ALUOutput = (id_ex.B != 0) ? id_ex.A % id_ex.B : id_ex.A;
+        }
+        else if (funct3 == 0x7 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = id_ex.A & id_ex.B;
+        }
+        else if (funct3 == 0x6 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = id_ex.A | id_ex.B;
+        }
+        else if (funct3 == 0x1 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = id_ex.A << (id_ex.B & 0x1F);
+        }
+        else if (funct3 == 0x5 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = (uint32_t)id_ex.A >> (id_ex.B & 0x1F);
+        }
+        else if (funct3 == 0x2 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = (id_ex.A < id_ex.B) ? 1 : 0;
+        }
+        else if (funct3 == 0x3 && funct7 == 0x00)
+        {
+            ex_mem_next.ALUOutput = ((uint32_t)id_ex.A < (uint32_t)id_ex.B) ? 1 : 0;
+        }
+    }
+    else if (opcode == 0x13)
+    {
+        if (funct3 == 0x0)
+        {
+            uint32_t bit30 = (id_ex.IR >> 30) & 0x1;
+            if (bit30 == 1)
+            {
+                ex_mem_next.ALUOutput = id_ex.A - id_ex.Imm;
+            }
+            else
+            {
+                ex_mem_next.ALUOutput = id_ex.A + id_ex.Imm;
+            }
+        }
+        else if (funct3 == 0x7)
+        {
+            ex_mem_next.ALUOutput = id_ex.A & id_ex.Imm;
+        }
+        else if (funct3 == 0x6)
+        {
+            ex_mem_next.ALUOutput = id_ex.A | id_ex.Imm;
+        }
+        else if (funct3 == 0x1)
+        {
+            ex_mem_next.ALUOutput = id_ex.A << (id_ex.Imm & 0x1F);
+        }
+        else if (funct3 == 0x5)
+        {
+            ex_mem_next.ALUOutput = (uint32_t)id_ex.A >> (id_ex.Imm & 0x1F);
+        }
+        else if (funct3 == 0x2)
+        {
+            ex_mem_next.ALUOutput = (id_ex.A < id_ex.Imm) ? 1 : 0;
+        }
+        else if (funct3 == 0x3)
+        {
+            ex_mem_next.ALUOutput = ((uint32_t)id_ex.A < (uint32_t)id_ex.Imm) ? 1 : 0;
+        }
+    }
+    else if (opcode == 0x03)
+    {
+        ex_mem_next.ALUOutput = id_ex.A + id_ex.Imm;
+    }
+    else if (opcode == 0x23)
+    {
+        ex_mem_next.ALUOutput = id_ex.A + id_ex.Imm;
+    }
+    else if (opcode == 0x63)
+    {
+        if (funct3 == 0x0)
+        {
+            ex_mem_next.cond = (id_ex.A == id_ex.B);
+        }
+        branch_target = id_ex.PC + id_ex.Imm;
+
+        if (ex_mem_next.cond)
+        {
+            PC = branch_target;
+        }
+        else
+        {
+            PC = id_ex.NPC;
+        }
+        branch_taken = true;
+        squash_if_id = true;
+    }
+    else if (opcode == 0x37)
+    {
+        ex_mem_next.ALUOutput = id_ex.Imm;
+    }
+    else if (opcode == 0x6F)
+    {
+        ex_mem_next.ALUOutput = id_ex.NPC;
+        PC = id_ex.PC + id_ex.Imm;
+        branch_taken = true;
+        squash_if_id = true;
+    }
+    else if (opcode == 0x67)
+    { // jalr
+        ex_mem_next.ALUOutput = id_ex.NPC;
+        PC = (id_ex.A + id_ex.Imm) & ~1;
+        branch_taken = true;
+        squash_if_id = true;
+    }
+}
+
+void RISCVSimulator::MEM_stage()
+{
+    if (!ex_mem.valid)
+    {
+        mem_wb_next = MEM_WB();
+        return;
+    }
+
+    // Everything older has retired by now, so the fault is precise.
+    if (ex_mem.IR == ILLEGAL_INSTRUCTION)
+    {
+        faulted = true;
+        faultPC = ex_mem.PC;
+        stopReason = STOP_ILLEGAL;
+        stopAddress = ex_mem.PC;
+        mem_wb_next = MEM_WB();
+        return;
+    }
+
+    uint32_t opcode = getOpcode(ex_mem.IR);
+
+    mem_wb_next.IR = ex_mem.IR;
+    mem_wb_next.ALUOutput = ex_mem.ALUOutput;
+    mem_wb_next.seq = ex_mem.seq;
+    mem_wb_next.valid = true;
+    mem_utilization++;
+
+    if (opcode == 0x03)
+    {
+        int address = ex_mem.ALUOutput / 4;
+        if (address >= 0 && address < dataMemory.size())
+        {
+            mem_wb_next.LMD = dataMemory[address];
+            if (dram.isEnabled())
+                accessMemory(dataPrefetches, dataPrefetcher, ex_mem.PC, ex_mem.ALUOutput, memoryRequest, memoryLine);
+            NOTIFY(onMemoryAccess(totalCycles, ex_mem.seq, ex_mem.ALUOutput, mem_wb_next.LMD, false));
+        }
+    }
+    else if (opcode == 0x23)
+    {
+        int address = ex_mem.ALUOutput / 4;
+        if (address >= 0 && address < dataMemory.size())
+        {
+            storeWord(address, ex_mem.B);
+            if (dram.isEnabled())
+                accessMemory(dataPrefetches, dataPrefetcher, ex_mem.PC, ex_mem.ALUOutput, memoryRequest, memoryLine);
+            NOTIFY(onMemoryAccess(totalCycles, ex_mem.seq, ex_mem.ALUOutput, ex_mem.B, true));
+
+            if (isWatched(address))
+            {
+                stopReason = STOP_WATCHPOINT;
+                stopAddress = ex_mem.ALUOutput;
+            }
+        }
+    }
+}
+
+void RISCVSimulator::WB_stage()
+{
+    if (!mem_wb.valid)
+    {
+        return;
+    }
+
+    uint32_t opcode = getOpcode(mem_wb.IR);
+    uint32_t rd = writesRegister(mem_wb.IR) ? getRd(mem_wb.IR) : 0;
+
+    wb_utilization++;
+
+    if (rd != 0)
+    {
+        if (opcode == 0x03)
+        { // lw
+            writeRegister(rd, mem_wb.LMD);
+        }
+        else
+        {
+            writeRegister(rd, mem_wb.ALUOutput);
+
+            if (opcode == 0x33 && getFunct3(mem_wb.IR) == 0x0 &&
+                getFunct7(mem_wb.IR) == 0x01 && rd < 31)
+            {
+                uint32_t rs1 = getRs1(mem_wb.IR);
+                uint32_t rs2 = getRs2(mem_wb.IR);
+                int64_t result = (int64_t)registers[rs1] * (int64_t)registers[rs2];
+                writeRegister(rd + 1, (int32_t)(result >> 32));
+            }
+        }
+    }
+
+    if (mem_wb.IR == ECALL_INSTRUCTION)
+    {
+        handleSyscall();
+        trapPending = exited;
+        rd = 10; // a0 holds the result
+    }
+
+    registers[0] = 0;
+    instructionsCompleted++;
+
+    if (rd != 0 && rd == (uint32_t)stopRegister && registers[rd] == stopRegisterValue)
+    {
+        stopReason = STOP_REGISTER;
+    }
+    NOTIFY(onRetire(totalCycles, mem_wb.seq, mem_wb.IR));
+}
+
+string RISCVSimulator::getRegisterName(int reg)
+{
+    const char *names[] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0/fp", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+        "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+    return names[reg];
+}
+
+void RISCVSimulator::runCycle()
+{
+    if (journal.enabled)
+        beginCycleRecord();
+
+    stopReason = STOP_NONE;
+    flushed = false;
+    if (isMemoryBusy() && waitForMemory())
+    {
+        memoryStallCycles++;
+        totalCycles++;
+        if (journal.enabled)
+            endCycleRecord();
+        NOTIFY(onCycleEnd(*this));
+        if (sampler && totalCycles - samplerCycle >= samplerInterval)
+            runSampler();
+        return;
+    }
+
+    bool was_stalled = stall;
+    stall = false;
+
+    WB_stage();
+    MEM_stage();
+    EX_stage();
+    ID_stage();
+
+    if (!was_stalled || !stall)
+    {
+        IF_stage();
+    }
+    else
+    {
+        if_id_next = if_id;
+    }
+
+    mem_wb = mem_wb_next;
+    ex_mem = ex_mem_next;
+    id_ex = id_ex_next;
+
+    if (!stall)
+    {
+        if_id = if_id_next;
+        if (if_id.valid)
+        {
+            if_id.seq = nextSeq++;
+            fetchedInstructions++;
+            if (if_id.NPC - if_id.PC == 2)
+                fetchedCompressed++;
+            NOTIFY(onFetch(totalCycles, if_id.seq, if_id.PC, if_id.IR));
+        }
+    }
+
+    if (!stall && !branch_taken && !trapPending)
+    {
+        PC += fetchLength;
+    }
+
+    branch_taken = false;
+
+    if (dram.isEnabled())
+        dram.advance(totalCycles);
+
+    totalCycles++;
+
+    if (journal.enabled)
+        endCycleRecord();
+
+    NOTIFY(onCycleEnd(*this));
+    if (sampler && totalCycles - samplerCycle >= samplerInterval)
+        runSampler();
+}
+
+void RISCVSimulator::writeRegister(uint32_t rd, int32_t value)
+{
+    if (journal.enabled && registers[rd] != value)
+    {
+        RegisterWrite write = {(uint8_t)rd, registers[rd]};
+        journal.registerWrites.push_back(write);
+    }
+    registers[rd] = value;
+}
+
+void RISCVSimulator::storeWord(uint32_t index, int32_t value)
+{
+    if (journal.enabled && dataMemory[index] != value)
+    {
+        MemoryWrite write = {index, dataMemory[index]};
+        journal.memoryWrites.push_back(write);
+    }
+    dataMemory[index] = value;
+}
+
+void RISCVSimulator::setRegister(int reg, int32_t value)
+{
+    if (reg != 0)
+        writeRegister(reg, value);
+}
+
+void RISCVSimulator::setDataWord(size_t index, int32_t value)
+{
+    if (index >= dataMemory.size())
+        dataMemory.resize(index + 1, 0);
+    storeWord(index, value);
+}
+
+bool RISCVSimulator::configureDram(const DramConfig &config)
+{
+    if (!dram.configure(config))
+        return false;
+    fetchRequest = memoryRequest = fetchLine = memoryLine = -1;
+    memoryReady = 0;
+    instructionPrefetches.reset();
+    dataPrefetches.reset();
+    restartHistory();
+    return true;
+}
+
+void RISCVSimulator::disableDram()
+{
+    dram.disable();
+    fetchRequest = memoryRequest = fetchLine = memoryLine = -1;
+    memoryReady = 0;
+    restartHistory();
+}
+
+void RISCVSimulator::setInstructionPrefetcher(Prefetcher *prefetcher)
+{
+    instructionPrefetcher = prefetcher;
+    if (prefetcher)
+        prefetcher->reset();
+    restartHistory();
+}
+
+void RISCVSimulator::setDataPrefetcher(Prefetcher *prefetcher)
+{
+    dataPrefetcher = prefetcher;
+    if (prefetcher)
+        prefetcher->reset();
+    restartHistory();
+}
+
+// Starts the DRAM side of a demand access: a line in the stream's prefetch
+// buffer is waited for, anything else becomes a DRAM request. The stream's
+// prefetcher then sees the access and may queue prefetches behind it.
+//
+// The DRAM queue cannot refuse the request: the pipeline only advances once
+// both demand slots are released, and prefetches never take the last
+// PrefetchBuffer::RESERVED_SLOTS, so one is always free for IF and one for MEM.
+void RISCVSimulator::accessMemory(PrefetchBuffer &buffer, Prefetcher *prefetcher, uint32_t pc,
+                                  uint32_t address, int &request, int &line)
+{
+    int entry = buffer.lookup(address, totalCycles, dram);
+    if (entry < 0)
+    {
+        request = dram.request(address, totalCycles);
+        assert(request >= 0);
+    }
+    else
+    {
+        uint64_t ready = buffer.getReady(entry, dram);
+        if (ready == DramModel::PENDING)
+            line = entry;
+        else
+            memoryReady = max(memoryReady, ready);
+    }
+
+    if (prefetcher)
+    {
+        prefetchAddresses.clear();
+        prefetcher->onAccess(pc, address, entry < 0, prefetchAddresses);
+        for (size_t i = 0; i < prefetchAddresses.size(); i++)
+            buffer.prefetch(prefetchAddresses[i], totalCycles, dram);
+    }
+}
+
+bool RISCVSimulator::isMemoryBusy() const
+{
+    return fetchRequest >= 0 || memoryRequest >= 0 || fetchLine >= 0 || memoryLine >= 0 ||
+           memoryReady > (uint64_t)totalCycles;
+}
+
+// Returns true while data IF or MEM asked for has not arrived. Requests and
+// prefetched lines are dropped from the wait as soon as their arrival cycle
+// is known.
+bool RISCVSimulator::waitForMemory()
+{
+    dram.advance(totalCycles);
+    if (fetchRequest >= 0 && dram.completion(fetchRequest) != DramModel::PENDING)
+    {
+        memoryReady = max(memoryReady, dram.completion(fetchRequest));
+        dram.release(fetchRequest);
+        fetchRequest = -1;
+    }
+    if (memoryRequest >= 0 && dram.completion(memoryRequest) != DramModel::PENDING)
+    {
+        memoryReady = max(memoryReady, dram.completion(memoryRequest));
+        dram.release(memoryRequest);
+        memoryRequest = -1;
+    }
+    if (fetchLine >= 0 && instructionPrefetches.getReady(fetchLine, dram) != DramModel::PENDING)
+    {
+        memoryReady = max(memoryReady, instructionPrefetches.getReady(fetchLine, dram));
+        fetchLine = -1;
+    }
+    if (memoryLine >= 0 && dataPrefetches.getReady(memoryLine, dram) != DramModel::PENDING)
+    {
+        memoryReady = max(memoryReady, dataPrefetches.getReady(memoryLine, dram));
+        memoryLine = -1;
+    }
+    return isMemoryBusy();
+}
+
+// Byte-level view of data memory and host I/O for emulateSyscall().
+class RISCVSimulator::Guest
+{
+public:
+    explicit Guest(RISCVSimulator &sim) : sim(sim) {}
+
+    int32_t readRegister(int reg) { return sim.registers[reg]; }
+    void writeRegister(int reg, int32_t value) { sim.writeRegister(reg, value); }
+
+    bool loadByte(uint32_t address, uint8_t &value)
+    {
+        if (address / 4 >= sim.dataMemory.size())
+            return false;
+        value = (uint8_t)((uint32_t)sim.dataMemory[address / 4] >> (8 * (address % 4)));
+        return true;
+    }
+
+    bool storeByte(uint32_t address, uint8_t value)
+    {
+        if (address / 4 >= sim.dataMemory.size())
+            return false;
+        uint32_t shift = 8 * (address % 4);
+        uint32_t word = (uint32_t)sim.dataMemory[address / 4];
+        word = (word & ~(0xFFu << shift)) | ((uint32_t)value << shift);
+        sim.storeWord(address / 4, (int32_t)word);
+        return true;
+    }
+
+    uint32_t getBreak() { return sim.programBreak; }
+
+    bool setBreak(uint32_t address)
+    {
+        if (address > MAX_PROGRAM_BREAK)
+            return false;
+        size_t words = (address + 3) / 4;
+        if (words > sim.dataMemory.size())
+        {
+            // The first growth reserves up to the limit, so data memory moves
+            // at most once under getDataMemory() views. Programs that never
+            // grow the break do not pay for the reservation.
+            if (sim.dataMemory.capacity() < MAX_PROGRAM_BREAK / 4)
+                sim.dataMemory.reserve(MAX_PROGRAM_BREAK / 4);
+            sim.dataMemory.resize(words, 0);
+        }
+        sim.programBreak = address;
+        return true;
+    }
+
+    uint64_t getCycles() { return sim.totalCycles; }
+    void output(int fd, const char *data, size_t size) { sim.emitOutput(fd, data, size); }
+    size_t input(char *data, size_t size) { return sim.readInput(data, size); }
+
+    void exit(int32_t code)
+    {
+        sim.exited = true;
+        sim.exitCode = code;
+        sim.flushOutput();
+    }
+
+private:
+    RISCVSimulator &sim;
+};
+
+void RISCVSimulator::handleSyscall()
+{
+    Guest guest(*this);
+    emulateSyscall(guest);
+}
+
+// Output is tracked by its offset in the guest's output stream, so writes
+// re-executed after stepping back are not emitted a second time.
+void RISCVSimulator::emitOutput(int fd, const char *data, size_t size)
+{
+    uint32_t start = outputOffset;
+    outputOffset += size;
+    if (outputOffset <= outputEmitted)
+        return;
+    if (start < outputEmitted)
+    {
+        data += outputEmitted - start;
+        size -= outputEmitted - start;
+    }
+    outputEmitted = outputOffset;
+
+    if (fd != outputFd)
+        flushOutput();
+    outputFd = fd;
+    outputBuffer.append(data, size);
+    if (outputBuffer.size() >= OUTPUT_FLUSH_BYTES)
+        flushOutput();
+}
+
+// Returns up to size bytes of guest input, stopping after a newline. Bytes
+// come from inputHistory when this read is being re-executed.
+size_t RISCVSimulator::readInput(char *data, size_t size)
+{
+    if (inputOffset == inputHistory.size())
+    {
+        flushOutput();
+        for (size_t i = 0; i < size; i++)
+        {
+            int c = fgetc(hostFiles[0]);
+            if (c == EOF)
+                break;
+            inputHistory.push_back((char)c);
+            if (c == '\n')
+                break;
+        }
+    }
+
+    size_t count = 0;
+    while (count < size && inputOffset < inputHistory.size())
+    {
+        char c = inputHistory[inputOffset++];
+        data[count++] = c;
+        if (c == '\n')
+            break;
+    }
+    return count;
+}
+
+void RISCVSimulator::flushOutput()
+{
+    if (outputBuffer.empty())
+        return;
+    FILE *file = hostFiles[outputFd == 2 ? 2 : 1];
+    fwrite(outputBuffer.data(), 1, outputBuffer.size(), file);
+    fflush(file);
+    outputBuffer.clear();
+}
+
+void RISCVSimulator::setSyscallStreams(FILE *input, FILE *output, FILE *error)
+{
+    hostFiles[0] = input;
+    hostFiles[1] = output;
+    hostFiles[2] = error;
+}
+
+void RISCVSimulator::runInstruction()
+{
+    int64_t instructionsBefore = instructionsCompleted;
+    while (instructionsCompleted == instructionsBefore && !isProgramComplete())
+    {
+        runCycle();
+    }
+}
+
+int RISCVSimulator::step(int cycles)
+{
+    int executed = 0;
+    while (executed < cycles && !isProgramComplete())
+    {
+        runCycle();
+        executed++;
+    }
+    return executed;
+}
+
+void RISCVSimulator::addObserver(SimObserver *observer)
+{
+    observers.push_back(observer);
+}
+
+void RISCVSimulator::removeObserver(SimObserver *observer)
+{
+    observers.erase(remove(observers.begin(), observers.end(), observer), observers.end());
+}
+
+// The sampler is kept out of the observer list so that a periodic consumer
+// costs one comparison per cycle instead of a call per pipeline event.
+// reverseCycle() also runs it every interval cycles, so a consumer sees the
+// cycle count go down and sampling picks up from the rewound cycle.
+void RISCVSimulator::setSampler(SimObserver *observer, int interval)
+{
+    sampler = observer;
+    samplerInterval = interval < 1 ? 1 : interval;
+    samplerCycle = totalCycles;
+}
+
+void RISCVSimulator::runSampler()
+{
+    samplerCycle = totalCycles;
+    sampler->onCycleEnd(*this);
+}
+
+void RISCVSimulator::addBreakpoint(uint32_t pc)
+{
+    uint32_t half = pc / 2;
+    if (half / 64 >= breakpoints.size())
+        breakpoints.resize(half / 64 + 1, 0);
+    breakpoints[half / 64] |= 1ULL << (half % 64);
+}
+
+bool RISCVSimulator::isBreakpoint(uint32_t pc) const
+{
+    uint32_t half = pc / 2;
+    return half / 64 < breakpoints.size() && (breakpoints[half / 64] >> (half % 64)) & 1;
+}
+
+bool RISCVSimulator::isWatched(uint32_t index) const
+{
+    return index / PAGE_WORDS < watchedPages.size() && watchedPages[index / PAGE_WORDS] &&
+           (watchedWords[index / 64] >> (index % 64)) & 1;
+}
+
+void RISCVSimulator::removeBreakpoint(uint32_t pc)
+{
+    uint32_t half = pc / 2;
+    if (half / 64 < breakpoints.size())
+        breakpoints[half / 64] &= ~(1ULL << (half % 64));
+}
+
+void RISCVSimulator::addWatchpoint(uint32_t address)
+{
+    uint32_t word = address / 4;
+    if (word / PAGE_WORDS >= watchedPages.size())
+    {
+        watchedPages.resize(word / PAGE_WORDS + 1, 0);
+        watchedWords.resize(watchedPages.size() * PAGE_WORDS / 64, 0);
+    }
+    watchedWords[word / 64] |= 1ULL << (word % 64);
+    watchedPages[word / PAGE_WORDS] = 1;
+}
+
+void RISCVSimulator::removeWatchpoint(uint32_t address)
+{
+    uint32_t word = address / 4;
+    if (word / PAGE_WORDS >= watchedPages.size())
+        return;
+
+    watchedWords[word / 64] &= ~(1ULL << (word % 64));
+
+    size_t first = (word / PAGE_WORDS) * PAGE_WORDS / 64;
+    bool anyWatched = false;
+    for (size_t i = first; i < first + PAGE_WORDS / 64; i++)
+        anyWatched = anyWatched || watchedWords[i] != 0;
+    watchedPages[word / PAGE_WORDS] = anyWatched;
+}
+
+void RISCVSimulator::clearBreakpoints()
+{
+    breakpoints.clear();
+    watchedPages.clear();
+    watchedWords.clear();
+}
+
+// Stops once a write-back leaves reg equal to value.
+void RISCVSimulator::setRegisterCondition(int reg, int32_t value)
+{
+    stopRegister = reg;
+    stopRegisterValue = value;
+}
+
+void RISCVSimulator::setCycleCondition(int64_t cycle)
+{
+    stopCycle = cycle;
+}
+
+void RISCVSimulator::setInstructionCondition(int64_t count)
+{
+    stopInstructions = count;
+}
+
+void RISCVSimulator::clearConditions()
+{
+    stopRegister = -1;
+    stopRegisterValue = 0;
+    stopCycle = -1;
+    stopInstructions = -1;
+}
+
+// Runs at full speed until a breakpoint instruction issues, a watched word
+// is stored to, a run-until condition is met, the program completes or
+// maxCycles elapse. Breakpoints are taken at issue, the first point where an
+// instruction can no longer be squashed.
+StopReason RISCVSimulator::runUntilStop(int maxCycles)
+{
+    stopReason = STOP_NONE;
+    for (int cycles = 0; cycles < maxCycles; cycles++)
+    {
+        if (isProgramComplete())
+            return stopReason = STOP_COMPLETE;
+
+        runCycle();
+
+        if (stopReason != STOP_NONE)
+            return stopReason;
+        if (totalCycles == stopCycle)
+            return stopReason = STOP_CYCLES;
+        if (instructionsCompleted == stopInstructions)
+            return stopReason = STOP_INSTRUCTIONS;
+    }
+    return stopReason = STOP_LIMIT;
+}
+
+Span<int32_t> RISCVSimulator::getDataPage(size_t page) const
+{
+    size_t start = min(page * PAGE_WORDS, dataMemory.size());
+    size_t end = min(start + PAGE_WORDS, dataMemory.size());
+    return Span<int32_t>(dataMemory.data() + start, end - start);
+}
+
+bool RISCVSimulator::isProgramComplete() const
+{
+    if (exited || faulted)
+        return true;
+    return !if_id.valid && !id_ex.valid && !ex_mem.valid && !mem_wb.valid &&
+           !isMemoryBusy() &&
+           readParcel(instructionMemory.data(), instructionMemory.size(), PC) == 0;
+}
+
+void RISCVSimulator::captureScalars(ScalarState &state) const
+{
+    // Cleared first so that padding bytes never show up as journal changes.
+    memset(static_cast<void *>(&state), 0, sizeof(state));
+    state.PC = PC;
+    state.branch_target = branch_target;
+    state.totalCycles = totalCycles;
+    state.if_utilization = if_utilization;
+    state.id_utilization = id_utilization;
+    state.ex_utilization = ex_utilization;
+    state.mem_utilization = mem_utilization;
+    state.wb_utilization = wb_utilization;
+    state.instructionsCompleted = instructionsCompleted;
+    state.hazardStallCycles = hazardStallCycles;
+    state.flushedInstructions = flushedInstructions;
+    state.nextSeq = nextSeq;
+    state.stall = stall;
+    state.branch_taken = branch_taken;
+    state.squash_if_id = squash_if_id;
+    state.flushed = flushed;
+    state.trapPending = trapPending;
+    state.exited = exited;
+    state.exitCode = exitCode;
+    state.faulted = faulted;
+    state.faultPC = faultPC;
+    state.programBreak = programBreak;
+    state.inputOffset = inputOffset;
+    state.outputOffset = outputOffset;
+    state.fetchBuffer = fetchBuffer;
+    state.fetchLength = fetchLength;
+    state.fetchBlockReads = fetchBlockReads;
+    state.fetchedInstructions = fetchedInstructions;
+    state.fetchedCompressed = fetchedCompressed;
+    state.fetchRequest = fetchRequest;
+    state.memoryRequest = memoryRequest;
+    state.fetchLine = fetchLine;
+    state.memoryLine = memoryLine;
+    state.memoryReady = memoryReady;
+    state.memoryStallCycles = memoryStallCycles;
+}
+
+void RISCVSimulator::restoreScalars(const ScalarState &state)
+{
+    PC = state.PC;
+    branch_target = state.branch_target;
+    totalCycles = state.totalCycles;
+    if_utilization = state.if_utilization;
+    id_utilization = state.id_utilization;
+    ex_utilization = state.ex_utilization;
+    mem_utilization = state.mem_utilization;
+    wb_utilization = state.wb_utilization;
+    instructionsCompleted = state.instructionsCompleted;
+    hazardStallCycles = state.hazardStallCycles;
+    flushedInstructions = state.flushedInstructions;
+    nextSeq = state.nextSeq;
+    stall = state.stall;
+    branch_taken = state.branch_taken;
+    squash_if_id = state.squash_if_id;
+    flushed = state.flushed;
+    trapPending = state.trapPending;
+    exited = state.exited;
+    exitCode = state.exitCode;
+    faulted = state.faulted;
+    faultPC = state.faultPC;
+    programBreak = state.programBreak;
+    inputOffset = state.inputOffset;
+    outputOffset = state.outputOffset;
+    fetchBuffer = state.fetchBuffer;
+    fetchLength = state.fetchLength;
+    fetchBlockReads = state.fetchBlockReads;
+    fetchedInstructions = state.fetchedInstructions;
+    fetchedCompressed = state.fetchedCompressed;
+    fetchRequest = state.fetchRequest;
+    memoryRequest = state.memoryRequest;
+    fetchLine = state.fetchLine;
+    memoryLine = state.memoryLine;
+    memoryReady = state.memoryReady;
+    memoryStallCycles = state.memoryStallCycles;
+}
+
+unsigned char *RISCVSimulator::latchBytes(int latch, size_t &size)
+{
+    static_assert(sizeof(ID_EX) <= MAX_LATCH_SIZE, "MAX_LATCH_SIZE too small for ID_EX");
+
+    switch (latch)
+    {
+    case 0:
+        size = sizeof(if_id);
+        return reinterpret_cast<unsigned char *>(&if_id);
+    case 1:
+        size = sizeof(if_id_next);
+        return reinterpret_cast<unsigned char *>(&if_id_next);
+    case 2:
+        size = sizeof(id_ex);
+        return reinterpret_cast<unsigned char *>(&id_ex);
+    case 3:
+        size = sizeof(id_ex_next);
+        return reinterpret_cast<unsigned char *>(&id_ex_next);
+    case 4:
+        size = sizeof(ex_mem);
+        return reinterpret_cast<unsigned char *>(&ex_mem);
+    case 5:
+        size = sizeof(ex_mem_next);
+        return reinterpret_cast<unsigned char *>(&ex_mem_next);
+    case 6:
+        size = sizeof(mem_wb);
+        return reinterpret_cast<unsigned char *>(&mem_wb);
+    default:
+        size = sizeof(mem_wb_next);
+        return reinterpret_cast<unsigned char *>(&mem_wb_next);
+    }
+}
+
+void RISCVSimulator::beginCycleRecord()
+{
+    CycleRecord record;
+    record.registerBegin = journal.registerWrites.size();
+    record.memoryBegin = journal.memoryWrites.size();
+    record.blockBegin = journal.blockDeltas.size();
+    record.bytesBegin = journal.blockBytes.size();
+    record.frozen = false;
+    journal.cycles.push_back(record);
+    captureScalars(scalarsBefore);
+    if (dram.isEnabled())
+        captureTiming(timingBefore);
+
+    for (int i = 0; i < 8; i++)
+    {
+        size_t size;
+        const unsigned char *latch = latchBytes(i, size);
+        memcpy(latchesBefore[i], latch, size);
+    }
+}
+
+void RISCVSimulator::endCycleRecord()
+{
+    ScalarState scalars;
+    captureScalars(scalars);
+    journal.cycles.back().frozen = scalars.memoryStallCycles != scalarsBefore.memoryStallCycles;
+    journalBlocks(0, reinterpret_cast<const unsigned char *>(&scalars),
+                  reinterpret_cast<const unsigned char *>(&scalarsBefore), sizeof(scalars));
+    for (int i = 0; i < 8; i++)
+    {
+        size_t size;
+        const unsigned char *latch = latchBytes(i, size);
+        journalBlocks(LATCH_REGION + i, latch, latchesBefore[i], size);
+    }
+    if (dram.isEnabled())
+    {
+        unsigned char *regions[MAX_TIMING_REGIONS];
+        size_t sizes[MAX_TIMING_REGIONS];
+        int count = timingRegions(regions, sizes);
+        size_t offset = 0;
+        for (int i = 0; i < count; i++)
+        {
+            journalBlocks(TIMING_REGION + i, regions[i], &timingBefore[offset], sizes[i]);
+            offset += sizes[i];
+        }
+    }
+
+    if (journal.cycles.size() > journal.maxCycles)
+        journal.trim(totalCycles);
+
+    if (totalCycles % journal.checkpointInterval == 0 &&
+        (journal.checkpoints.empty() || journal.checkpoints.back().scalars.totalCycles < totalCycles))
+        takeCheckpoint();
+}
+
+// Appends the BLOCK_SIZE pieces of a region that differ from their contents
+// at the start of the cycle to the newest record. Adjacent changed blocks
+// extend one delta.
+void RISCVSimulator::journalBlocks(int region, const unsigned char *current, const unsigned char *before, size_t size)
+{
+    assert(size <= BlockDelta::MAX_REGION_SIZE);
+    if (memcmp(current, before, size) == 0)
+        return;
+
+    size_t first = journal.cycles.back().blockBegin;
+    for (size_t begin = 0; begin < size; begin += BlockDelta::BLOCK_SIZE)
+    {
+        size_t length = size - begin < BlockDelta::BLOCK_SIZE ? size - begin : BlockDelta::BLOCK_SIZE;
+        if (memcmp(current + begin, before + begin, length) == 0)
+            continue;
+
+        BlockDelta *last = journal.blockDeltas.size() > first ? &journal.blockDeltas.back() : NULL;
+        if (last && last->region == region && last->begin + last->size == begin)
+            last->size += length;
+        else
+        {
+            BlockDelta delta = {(uint16_t)begin, (uint16_t)length, (uint8_t)region};
+            journal.blockDeltas.push_back(delta);
+        }
+        journal.blockBytes.insert(journal.blockBytes.end(), before + begin, before + begin + length);
+    }
+}
+
+void RISCVSimulator::undoCycle()
+{
+    const CycleRecord &record = journal.cycles.back();
+
+    for (size_t i = journal.memoryWrites.size(); i > record.memoryBegin; i--)
+        dataMemory[journal.memoryWrites[i - 1].index] = journal.memoryWrites[i - 1].oldValue;
+    for (size_t i = journal.registerWrites.size(); i > record.registerBegin; i--)
+        registers[journal.registerWrites[i - 1].reg] = journal.registerWrites[i - 1].oldValue;
+
+    // Scalars are patched in a captured copy, the rest in place.
+    ScalarState scalars;
+    captureScalars(scalars);
+    unsigned char *regions[TIMING_REGION + MAX_TIMING_REGIONS];
+    size_t sizes[TIMING_REGION + MAX_TIMING_REGIONS];
+    regions[0] = reinterpret_cast<unsigned char *>(&scalars);
+    for (int i = 0; i < 8; i++)
+        regions[LATCH_REGION + i] = latchBytes(i, sizes[LATCH_REGION + i]);
+    timingRegions(regions + TIMING_REGION, sizes + TIMING_REGION);
+
+    size_t offset = record.bytesBegin;
+    for (size_t i = record.blockBegin; i < journal.blockDeltas.size(); i++)
+    {
+        const BlockDelta &delta = journal.blockDeltas[i];
+        memcpy(regions[delta.region] + delta.begin, &journal.blockBytes[offset], delta.size);
+        offset += delta.size;
+    }
+    restoreScalars(scalars);
+
+    journal.memoryWrites.resize(record.memoryBegin);
+    journal.registerWrites.resize(record.registerBegin);
+    journal.blockDeltas.resize(record.blockBegin);
+    journal.blockBytes.resize(record.bytesBegin);
+    journal.cycles.pop_back();
+}
+
+void RISCVSimulator::takeCheckpoint()
+{
+    journal.checkpoints.push_back(Checkpoint());
+    Checkpoint &checkpoint = journal.checkpoints.back();
+
+    captureScalars(checkpoint.scalars);
+    memcpy(checkpoint.registers, registers, sizeof(registers));
+    checkpoint.dataMemory = dataMemory;
+    for (int i = 0; i < 8; i++)
+    {
+        size_t size;
+        const unsigned char *latch = latchBytes(i, size);
+        memcpy(checkpoint.latches[i], latch, size);
+    }
+    if (dram.isEnabled())
+        captureTiming(checkpoint.timing);
+}
+
+// Timing-model state saved as raw bytes for undo: the DRAM model, both
+// prefetch buffers and the installed prefetchers' tables.
+int RISCVSimulator::timingRegions(unsigned char *regions[], size_t sizes[])
+{
+    int count = 0;
+    regions[count] = reinterpret_cast<unsigned char *>(&dram);
+    sizes[count++] = sizeof(dram);
+    regions[count] = reinterpret_cast<unsigned char *>(&instructionPrefetches);
+    sizes[count++] = sizeof(instructionPrefetches);
+    regions[count] = reinterpret_cast<unsigned char *>(&dataPrefetches);
+    sizes[count++] = sizeof(dataPrefetches);
+    if (instructionPrefetcher)
+    {
+        regions[count] = static_cast<unsigned char *>(instructionPrefetcher->getState());
+        sizes[count++] = instructionPrefetcher->getStateSize();
+    }
+    if (dataPrefetcher)
+    {
+        regions[count] = static_cast<unsigned char *>(dataPrefetcher->getState());
+        sizes[count++] = dataPrefetcher->getStateSize();
+    }
+    return count;
+}
+
+void RISCVSimulator::captureTiming(vector<unsigned char> &bytes)
+{
+    unsigned char *regions[MAX_TIMING_REGIONS];
+    size_t sizes[MAX_TIMING_REGIONS];
+    int count = timingRegions(regions, sizes);
+    bytes.clear();
+    for (int i = 0; i < count; i++)
+        bytes.insert(bytes.end(), regions[i], regions[i] + sizes[i]);
+}
+
+void RISCVSimulator::restoreTiming(const vector<unsigned char> &bytes)
+{
+    unsigned char *regions[MAX_TIMING_REGIONS];
+    size_t sizes[MAX_TIMING_REGIONS];
+    int count = timingRegions(regions, sizes);
+    size_t offset = 0;
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(regions[i], &bytes[offset], sizes[i]);
+        offset += sizes[i];
+    }
+}
+
+void RISCVSimulator::restartHistory()
+{
+    if (!journal.enabled)
+        return;
+    journal.clear();
+    takeCheckpoint();
+}
+
+// Restores the newest checkpoint before cycle and re-executes up to it,
+// rebuilding the journal for that stretch. Observers are not notified.
+bool RISCVSimulator::replayTo(int64_t cycle)
+{
+    size_t index = journal.checkpoints.size();
+    while (index > 0 && journal.checkpoints[index - 1].scalars.totalCycles >= max(cycle, (int64_t)1))
+        index--;
+    if (index == 0)
+        return false;
+
+    const Checkpoint &checkpoint = journal.checkpoints[index - 1];
+    restoreScalars(checkpoint.scalars);
+    memcpy(registers, checkpoint.registers, sizeof(registers));
+    // Copied in place: data memory never shrinks while running, so views of it
+    // handed out by getDataMemory() stay valid.
+    dataMemory.resize(checkpoint.dataMemory.size());
+    copy(checkpoint.dataMemory.begin(), checkpoint.dataMemory.end(), dataMemory.begin());
+    for (int i = 0; i < 8; i++)
+    {
+        size_t size;
+        unsigned char *latch = latchBytes(i, size);
+        memcpy(latch, checkpoint.latches[i], size);
+    }
+    if (!checkpoint.timing.empty())
+        restoreTiming(checkpoint.timing);
+
+    journal.clearCycles();
+
+    vector<SimObserver *> muted;
+    muted.swap(observers);
+    SimObserver *mutedSampler = sampler;
+    sampler = NULL;
+    while (totalCycles < cycle)
+        runCycle();
+    observers.swap(muted);
+    sampler = mutedSampler;
+    return true;
+}
+
+// Starts recording an undo journal, keeping at most maxCycles of deltas and a
+// full checkpoint every checkpointInterval cycles.
+void RISCVSimulator::enableHistory(size_t maxCycles, int checkpointInterval)
+{
+    journal.enabled = true;
+    journal.maxCycles = maxCycles;
+    journal.checkpointInterval = checkpointInterval < 1 ? 1 : checkpointInterval;
+    restartHistory();
+}
+
+void RISCVSimulator::disableHistory()
+{
+    journal.enabled = false;
+    journal.clear();
+}
+
+bool RISCVSimulator::reverseCycle()
+{
+    if (!journal.enabled || totalCycles == 0)
+        return false;
+
+    if (journal.cycles.empty())
+    {
+        if (!replayTo(totalCycles - 1))
+            return false;
+    }
+    else
+        undoCycle();
+
+    NOTIFY(onRewind(totalCycles));
+    if (sampler && samplerCycle - totalCycles >= samplerInterval)
+        runSampler();
+    return true;
+}
+
+// Steps back to the last state before the most recent retirement.
+bool RISCVSimulator::reverseInstruction()
+{
+    int64_t target = instructionsCompleted - 1;
+    if (target < 0)
+        return false;
+
+    while (instructionsCompleted > target)
+    {
+        if (!reverseCycle())
+            return false;
+    }
+    return true;
+}
+
+// True if the newest journal record is a cycle the pipeline spent waiting for
+// DRAM, in which no stage ran and so nothing could have stopped.
+bool RISCVSimulator::lastCycleFrozen() const
+{
+    return !journal.cycles.empty() && journal.cycles.back().frozen;
+}
+
+// Register that WB wrote in the cycle of record (0 if none), applying the same
+// rule as WB_stage() to the instruction that retired in it.
+uint32_t RISCVSimulator::retiredRegister(const CycleRecord &record) const
+{
+    MEM_WB retired = mem_wb;
+    unsigned char *bytes = reinterpret_cast<unsigned char *>(&retired);
+    size_t offset = record.bytesBegin;
+    for (size_t i = record.blockBegin; i < journal.blockDeltas.size(); i++)
+    {
+        const BlockDelta &delta = journal.blockDeltas[i];
+        if (delta.region == LATCH_REGION + 6)
+            memcpy(bytes + delta.begin, &journal.blockBytes[offset], delta.size);
+        offset += delta.size;
+    }
+    if (!retired.valid)
+        return 0;
+    if (retired.IR == ECALL_INSTRUCTION)
+        return 10;
+    return writesRegister(retired.IR) ? getRd(retired.IR) : 0;
+}
+
+// Works out from the current state and the newest journal record whether
+// the cycle that produced this state would have stopped runUntilStop().
+StopReason RISCVSimulator::lastCycleStop()
+{
+    bool frozen = lastCycleFrozen();
+    if (!frozen && id_ex.valid && isBreakpoint(id_ex.PC))
+    {
+        stopAddress = id_ex.PC;
+        return STOP_BREAKPOINT;
+    }
+    int address = mem_wb.ALUOutput / 4;
+    if (!frozen && mem_wb.valid && getOpcode(mem_wb.IR) == 0x23 && address >= 0 &&
+        address < (int)dataMemory.size() && isWatched(address))
+    {
+        stopAddress = mem_wb.ALUOutput;
+        return STOP_WATCHPOINT;
+    }
+    if (!frozen && stopRegister > 0 && registers[stopRegister] == stopRegisterValue && !journal.cycles.empty() &&
+        retiredRegister(journal.cycles.back()) == (uint32_t)stopRegister)
+        return STOP_REGISTER;
+    if (totalCycles == stopCycle)
+        return STOP_CYCLES;
+    if (instructionsCompleted == stopInstructions)
+        return STOP_INSTRUCTIONS;
+    return STOP_NONE;
+}
+
+// Runs backwards until the state a forward runUntilStop() would have stopped
+// in, or until the start of the recorded history (STOP_LIMIT).
+StopReason RISCVSimulator::reverseContinue()
+{
+    while (reverseCycle())
+    {
+        stopReason = lastCycleStop();
+        if (stopReason != STOP_NONE)
+            return stopReason;
+    }
+    return stopReason = STOP_LIMIT;
+}
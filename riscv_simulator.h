@@ -0,0 +1,386 @@
+#ifndef RISCV_SIMULATOR_H
+#define RISCV_SIMULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "dram_model.h"
+#include "fetch_unit.h"
+#include "prefetcher.h"
+#include "sim_observer.h"
+#include "undo_journal.h"
+
+class MappedFile;
+
+// Read-only view over simulator-owned storage. Valid until the next
+// loadProgram() call, which may resize the memories. Data memory views are
+// also invalidated by setDataWord() past the end and by the first brk system
+// call that grows data memory; later brk calls do not move it.
+template <typename T>
+class Span
+{
+public:
+    Span(const T *data, size_t size) : ptr(data), count(size) {}
+
+    const T *data() const { return ptr; }
+    size_t size() const { return count; }
+    const T &operator[](size_t i) const { return ptr[i]; }
+    const T *begin() const { return ptr; }
+    const T *end() const { return ptr + count; }
+
+private:
+    const T *ptr;
+    size_t count;
+};
+
+class IF_ID
+{
+public:
+    uint32_t IR;
+    uint32_t PC;
+    uint32_t NPC;
+    uint64_t seq;
+    bool valid;
+
+    IF_ID() : IR(0), PC(0), NPC(0), seq(0), valid(false) {}
+};
+
+class ID_EX
+{
+public:
+    uint32_t IR;
+    uint32_t PC;
+    uint32_t NPC;
+    int32_t A;
+    int32_t B;
+    int32_t Imm;
+    uint64_t seq;
+    bool valid;
+
+    ID_EX() : IR(0), PC(0), NPC(0), A(0), B(0), Imm(0), seq(0), valid(false) {}
+};
+
+class EX_MEM
+{
+public:
+    uint32_t IR;
+    uint32_t PC;
+    int32_t B;
+    int32_t ALUOutput;
+    bool cond;
+    uint64_t seq;
+    bool valid;
+
+    EX_MEM() : IR(0), PC(0), B(0), ALUOutput(0), cond(false), seq(0), valid(false) {}
+};
+
+class MEM_WB
+{
+public:
+    uint32_t IR;
+    int32_t ALUOutput;
+    int32_t LMD;
+    uint64_t seq;
+    bool valid;
+
+    MEM_WB() : IR(0), ALUOutput(0), LMD(0), seq(0), valid(false) {}
+};
+
+enum StopReason
+{
+    STOP_NONE,
+    STOP_COMPLETE,
+    STOP_BREAKPOINT,
+    STOP_WATCHPOINT,
+    STOP_REGISTER,
+    STOP_CYCLES,
+    STOP_INSTRUCTIONS,
+    STOP_ILLEGAL,
+    STOP_LIMIT
+};
+
+class RISCVSimulator
+{
+private:
+    std::vector<uint32_t> instructionMemory;
+    std::vector<int32_t> dataMemory;
+
+    int32_t registers[32];
+    uint32_t PC;
+    uint32_t entryPC;
+
+    IF_ID if_id, if_id_next;
+    ID_EX id_ex, id_ex_next;
+    EX_MEM ex_mem, ex_mem_next;
+    MEM_WB mem_wb, mem_wb_next;
+
+    int64_t totalCycles;
+    int64_t if_utilization, id_utilization, ex_utilization, mem_utilization, wb_utilization;
+    bool stall;
+    bool branch_taken;
+    bool squash_if_id;
+    bool flushed; // ID squashed a fetched instruction this cycle
+    uint32_t branch_target;
+    int64_t instructionsCompleted;
+    int64_t hazardStallCycles;   // cycles ID held an instruction for a data hazard
+    int64_t flushedInstructions; // fetched instructions squashed by taken branches
+    uint64_t nextSeq;
+
+    // Fetch. PCs are halfword aligned; IF reads instruction memory through
+    // fetchBuffer and expands RVC instructions, so IR always holds a 32-bit
+    // instruction and NPC - PC is 2 for a compressed one.
+    FetchBuffer fetchBuffer;
+    uint32_t fetchLength;
+    int64_t fetchBlockReads;
+    int64_t fetchedInstructions;
+    int64_t fetchedCompressed;
+    int staticInstructions;
+    int staticCompressed;
+
+    // DRAM timing (dram_model.h). When enabled, every IF block read and MEM
+    // access is a DRAM request made in the cycle the stage runs, and the
+    // whole pipeline then waits until the requests have completed. An access
+    // to a line in the stream's prefetch buffer waits for that line instead
+    // (fetchLine/memoryLine while its request is queued, then memoryReady).
+    DramModel dram;
+    int fetchRequest;
+    int memoryRequest;
+    int fetchLine;
+    int memoryLine;
+    uint64_t memoryReady;
+    int64_t memoryStallCycles;
+
+    // Prefetchers are owned by the caller and only run with DRAM timing.
+    Prefetcher *instructionPrefetcher;
+    Prefetcher *dataPrefetcher;
+    PrefetchBuffer instructionPrefetches;
+    PrefetchBuffer dataPrefetches;
+    std::vector<uint32_t> prefetchAddresses;
+
+    std::vector<SimObserver *> observers;
+    SimObserver *sampler;
+    int samplerInterval;
+    int64_t samplerCycle;
+
+    // Debug stops. Breakpoints are one bit per instruction halfword; watchpoints
+    // are one bit per data word, consulted only for pages flagged in
+    // watchedPages.
+    std::vector<uint64_t> breakpoints;
+    std::vector<uint8_t> watchedPages;
+    std::vector<uint64_t> watchedWords;
+    int stopRegister;
+    int32_t stopRegisterValue;
+    int64_t stopCycle;
+    int64_t stopInstructions;
+    StopReason stopReason;
+    uint32_t stopAddress;
+
+    // System calls (syscall_emulation.h). An ecall blocks fetch from issue
+    // until it retires, so it runs at WB with the pipeline drained. Guest
+    // output is buffered and written to the host in large chunks; input read
+    // so far is kept in inputHistory so re-executed reads see the same bytes.
+    bool trapPending;
+    bool exited;
+    int32_t exitCode;
+    bool faulted; // an illegal instruction reached MEM at faultPC
+    uint32_t faultPC;
+    uint32_t programBreak;
+    uint32_t initialBreak;
+    uint32_t inputOffset;
+    uint32_t outputOffset;
+    uint32_t outputEmitted;
+    std::string inputHistory;
+    std::string outputBuffer;
+    int outputFd;
+    FILE *hostFiles[3];
+
+    UndoJournal journal;
+    ScalarState scalarsBefore;
+    unsigned char latchesBefore[8][MAX_LATCH_SIZE];
+    std::vector<unsigned char> timingBefore;
+
+    bool checkDataHazard();
+    bool lastCycleFrozen() const;
+    uint32_t retiredRegister(const CycleRecord &record) const;
+    bool waitForMemory();
+    void runSampler();
+    bool isMemoryBusy() const;
+    void accessMemory(PrefetchBuffer &buffer, Prefetcher *prefetcher, uint32_t pc, uint32_t address,
+                      int &request, int &line);
+
+    void writeRegister(uint32_t rd, int32_t value);
+    void storeWord(uint32_t index, int32_t value);
+
+    void captureScalars(ScalarState &state) const;
+    void restoreScalars(const ScalarState &state);
+    unsigned char *latchBytes(int latch, size_t &size);
+    void beginCycleRecord();
+    void endCycleRecord();
+    void undoCycle();
+    void takeCheckpoint();
+    void restartHistory();
+    bool replayTo(int64_t cycle);
+    StopReason lastCycleStop();
+    static const int MAX_TIMING_REGIONS = 5;
+    // Journal region numbers: the scalar state, the eight latches, then the
+    // timing regions.
+    static const int LATCH_REGION = 1;
+    static const int TIMING_REGION = 9;
+    void journalBlocks(int region, const unsigned char *current, const unsigned char *before, size_t size);
+    int timingRegions(unsigned char *regions[], size_t sizes[]);
+    void captureTiming(std::vector<unsigned char> &bytes);
+    void restoreTiming(const std::vector<unsigned char> &bytes);
+    bool isBreakpoint(uint32_t pc) const;
+    bool isWatched(uint32_t index) const;
+
+    bool loadHex(const MappedFile &file);
+    bool loadImage(const MappedFile &file, const std::string &filename);
+    void measureCode();
+
+    class Guest;
+    void handleSyscall();
+    void emitOutput(int fd, const char *data, size_t size);
+    size_t readInput(char *data, size_t size);
+
+public:
+    static const size_t PAGE_WORDS = 256;
+
+    RISCVSimulator();
+    ~RISCVSimulator();
+    bool loadProgram(const std::string &filename);
+    bool saveImage(const std::string &filename);
+    void reset();
+    void runCycle();
+    void runInstruction();
+    int step(int cycles);
+    template <typename Predicate>
+    int runUntil(Predicate done, int maxCycles);
+
+    void IF_stage();
+    void ID_stage();
+    void EX_stage();
+    void MEM_stage();
+    void WB_stage();
+
+    bool isProgramComplete() const;
+    int64_t getTotalCycles() const { return totalCycles; }
+    int64_t getInstructionsCompleted() const { return instructionsCompleted; }
+    int64_t getHazardStallCycles() const { return hazardStallCycles; }
+    int64_t getFlushedInstructions() const { return flushedInstructions; }
+    uint32_t getPC() const { return PC; }
+
+    Span<int32_t> getRegisters() const { return Span<int32_t>(registers, 32); }
+    Span<uint32_t> getInstructionMemory() const { return Span<uint32_t>(instructionMemory.data(), instructionMemory.size()); }
+    Span<int32_t> getDataMemory() const { return Span<int32_t>(dataMemory.data(), dataMemory.size()); }
+    Span<int32_t> getDataPage(size_t page) const;
+    size_t getDataPageCount() const { return (dataMemory.size() + PAGE_WORDS - 1) / PAGE_WORDS; }
+
+    void setRegister(int reg, int32_t value);
+    void setDataWord(size_t index, int32_t value);
+
+    const IF_ID &getIFID() const { return if_id; }
+    const ID_EX &getIDEX() const { return id_ex; }
+    const EX_MEM &getEXMEM() const { return ex_mem; }
+    const MEM_WB &getMEMWB() const { return mem_wb; }
+
+    bool isStalled() const { return stall; }
+    bool isFlushing() const { return flushed; }
+    int64_t getIFUtilization() const { return if_utilization; }
+    int64_t getIDUtilization() const { return id_utilization; }
+    int64_t getEXUtilization() const { return ex_utilization; }
+    int64_t getMEMUtilization() const { return mem_utilization; }
+    int64_t getWBUtilization() const { return wb_utilization; }
+
+    // Code density and fetch bandwidth. Fetch block reads are of
+    // FetchBuffer::BLOCK_BYTES each; static counts cover the loaded program.
+    int64_t getFetchBlockReads() const { return fetchBlockReads; }
+    int64_t getFetchedInstructions() const { return fetchedInstructions; }
+    int64_t getFetchedCompressed() const { return fetchedCompressed; }
+    int getStaticInstructionCount() const { return staticInstructions; }
+    int getStaticCompressedCount() const { return staticCompressed; }
+
+    // Reconfiguring or disabling DRAM timing drops requests in flight and
+    // restarts the reverse-execution history.
+    bool configureDram(const DramConfig &config);
+    void disableDram();
+    const DramModel &getDram() const { return dram; }
+    int64_t getMemoryStallCycles() const { return memoryStallCycles; }
+
+    // Installs the prefetcher for instruction fetch or data accesses (NULL
+    // removes it). Changing a prefetcher restarts the reverse-execution
+    // history.
+    void setInstructionPrefetcher(Prefetcher *prefetcher);
+    void setDataPrefetcher(Prefetcher *prefetcher);
+    const Prefetcher *getInstructionPrefetcher() const { return instructionPrefetcher; }
+    const Prefetcher *getDataPrefetcher() const { return dataPrefetcher; }
+    const PrefetchBuffer &getInstructionPrefetches() const { return instructionPrefetches; }
+    const PrefetchBuffer &getDataPrefetches() const { return dataPrefetches; }
+
+    void setSyscallStreams(FILE *input, FILE *output, FILE *error);
+    void flushOutput();
+    bool hasExited() const { return exited; }
+    int32_t getExitCode() const { return exitCode; }
+    bool hasFaulted() const { return faulted; }
+    uint32_t getFaultPC() const { return faultPC; }
+
+    void addObserver(SimObserver *observer);
+    void removeObserver(SimObserver *observer);
+    // Calls observer->onCycleEnd() once every interval cycles, forwards or
+    // backwards (NULL removes it). Only onCycleEnd is delivered to a sampler.
+    void setSampler(SimObserver *observer, int interval);
+
+    void addBreakpoint(uint32_t pc);
+    void removeBreakpoint(uint32_t pc);
+    void addWatchpoint(uint32_t address);
+    void removeWatchpoint(uint32_t address);
+    void clearBreakpoints();
+    void setRegisterCondition(int reg, int32_t value);
+    void setCycleCondition(int64_t cycle);
+    void setInstructionCondition(int64_t count);
+    void clearConditions();
+    StopReason runUntilStop(int maxCycles);
+    StopReason getStopReason() const { return stopReason; }
+    uint32_t getStopAddress() const { return stopAddress; }
+
+    void enableHistory(size_t maxCycles = 100000, int checkpointInterval = 10000);
+    void disableHistory();
+    bool isHistoryEnabled() const { return journal.enabled; }
+    bool reverseCycle();
+    bool reverseInstruction();
+    StopReason reverseContinue();
+
+    static std::string getRegisterName(int reg);
+
+    static uint32_t getOpcode(uint32_t instruction);
+    static uint32_t getRd(uint32_t instruction);
+    static bool writesRegister(uint32_t instruction);
+    static uint32_t getRs1(uint32_t instruction);
+    static uint32_t getRs2(uint32_t instruction);
+    static uint32_t getFunct3(uint32_t instruction);
+    static uint32_t getFunct7(uint32_t instruction);
+    static int32_t getImmI(uint32_t instruction);
+    static int32_t getImmS(uint32_t instruction);
+    static int32_t getImmB(uint32_t instruction);
+    static int32_t getImmU(uint32_t instruction);
+    static int32_t getImmJ(uint32_t instruction);
+    static bool dependsOn(uint32_t instruction, uint32_t producer);
+};
+
+// Runs cycles until done(*this) holds, the program completes or maxCycles
+// have elapsed. Returns the number of cycles executed.
+template <typename Predicate>
+int RISCVSimulator::runUntil(Predicate done, int maxCycles)
+{
+    int cycles = 0;
+    while (cycles < maxCycles && !isProgramComplete() && !done(*this))
+    {
+        runCycle();
+        cycles++;
+    }
+    return cycles;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SIM_OBSERVER_H
+#define SIM_OBSERVER_H
+
+#include <cstdint>
+
+class RISCVSimulator;
+
+// Pipeline event callbacks. Every instruction gets a sequence number when it
+// is latched into IF/ID, and the same number is passed to all later events
+// for it. Observers are only called when attached, and building with
+// RISCV_SIM_NO_OBSERVERS removes the dispatch code entirely. onRewind() is
+// called after each step backwards; sequence numbers from the abandoned
+// future are reused when execution continues forward.
+class SimObserver
+{
+public:
+    virtual ~SimObserver() {}
+
+    virtual void onFetch(int64_t /*cycle*/, uint64_t /*seq*/, uint32_t /*pc*/, uint32_t /*instruction*/) {}
+    virtual void onIssue(int64_t /*cycle*/, uint64_t /*seq*/, uint32_t /*instruction*/) {}
+    virtual void onStall(int64_t /*cycle*/, uint64_t /*seq*/, uint32_t /*instruction*/) {}
+    virtual void onFlush(int64_t /*cycle*/, uint64_t /*seq*/, uint32_t /*instruction*/) {}
+    virtual void onRetire(int64_t /*cycle*/, uint64_t /*seq*/, uint32_t /*instruction*/) {}
+    virtual void onMemoryAccess(int64_t /*cycle*/, uint64_t /*seq*/, uint32_t /*address*/, int32_t /*value*/, bool /*isWrite*/) {}
+    virtual void onCycleEnd(const RISCVSimulator &) {}
+    virtual void onRewind(int64_t /*cycle*/) {}
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "metrics_segment.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+using namespace std;
+
+// Live view of a simulator started with --metrics. Rates are computed between
+// successive samples from the simulator's own clock, so they are unaffected
+// by how late simtop wakes up.
+
+static bool isRunning(uint32_t pid)
+{
+#ifndef _WIN32
+    return kill(pid, 0) == 0 || errno != ESRCH;
+#else
+    return true;
+#endif
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+static void displayStage(const char *name, uint64_t now, uint64_t before, uint64_t cycles, uint64_t totalCycles)
+{
+    cout << "  " << left << setw(5) << name << right << setw(8) << percent(now - before, cycles) << "%"
+         << setw(11) << percent(now, totalCycles) << "%\n";
+}
+
+static void display(const string &name, const MetricsReader &reader, const MetricsSample &now,
+                    const MetricsSample &before, const char *status)
+{
+    uint64_t cycles = now.totalCycles - before.totalCycles;
+    uint64_t instructions = now.instructionsCompleted > before.instructionsCompleted
+                                ? now.instructionsCompleted - before.instructionsCompleted
+                                : 0;
+    double seconds = (now.hostNanoseconds - before.hostNanoseconds) / 1e9;
+
+    cout << "\033[H\033[2J";
+    cout << "simtop - " << name << " (pid " << reader.getPid() << ", every " << reader.getInterval()
+         << " cycles, sample " << reader.getPublished() << ")" << status << "\n\n";
+
+    cout << fixed << setprecision(2);
+    cout << "Cycles:        " << setw(14) << now.totalCycles;
+    if (seconds > 0)
+        cout << setw(12) << cycles / seconds / 1e6 << " M/s";
+    cout << "\n";
+    cout << "Instructions:  " << setw(14) << now.instructionsCompleted;
+    if (seconds > 0)
+        cout << setw(12) << instructions / seconds / 1e6 << " M/s";
+    cout << "   IPC " << (cycles ? (double)instructions / cycles : 0.0) << "\n";
+    cout << "Host MIPS:     " << setw(14) << now.hostMips << "\n";
+
+    cout << "\nStage Utilization   recent     overall\n";
+    displayStage("IF", now.if_utilization, before.if_utilization, cycles, now.totalCycles);
+    displayStage("ID", now.id_utilization, before.id_utilization, cycles, now.totalCycles);
+    displayStage("EX", now.ex_utilization, before.ex_utilization, cycles, now.totalCycles);
+    displayStage("MEM", now.mem_utilization, before.mem_utilization, cycles, now.totalCycles);
+    displayStage("WB", now.wb_utilization, before.wb_utilization, cycles, now.totalCycles);
+
+    cout << "\nHazard Stalls: " << setw(14) << now.hazardStallCycles << setw(12)
+         << percent(now.hazardStallCycles, now.totalCycles) << "% of cycles\n";
+    cout << "Memory Stalls: " << setw(14) << now.memoryStallCycles << setw(12)
+         << percent(now.memoryStallCycles, now.totalCycles) << "% of cycles\n";
+    cout << "Flushes:       " << setw(14) << now.flushedInstructions << setw(12)
+         << percent(now.flushedInstructions, now.instructionsCompleted) << "% of retired\n";
+    cout << flush;
+}
+
+int main(int argc, char *argv[])
+{
+    string name = argc > 1 ? argv[1] : "/riscv-sim";
+    int refresh = argc > 2 ? atoi(argv[2]) : 1000;
+    if (refresh < 1)
+    {
+        cerr << "Usage: simtop [segment] [refresh-ms]" << endl;
+        return 1;
+    }
+
+    MetricsReader reader;
+    MetricsSample sample, now = MetricsSample(), before = MetricsSample();
+    bool attached = false;
+    bool waiting = false;
+
+    for (;;)
+    {
+        if (!reader.isOpen() && !reader.open(name))
+        {
+            if (!waiting)
+                cout << "Waiting for " << name << "..." << endl;
+            waiting = true;
+            this_thread::sleep_for(chrono::milliseconds(refresh));
+            continue;
+        }
+
+        bool running = isRunning(reader.getPid());
+        if (reader.readLatest(sample))
+        {
+            // Rates cover the samples of consecutive refreshes. The first
+            // refresh, and one after stepping backwards, compares against an
+            // empty sample so IPC and utilization are for the whole run.
+            bool fresh = !attached || sample.hostNanoseconds != now.hostNanoseconds;
+            if (!attached || sample.totalCycles < now.totalCycles)
+            {
+                now = MetricsSample();
+                now.hostNanoseconds = sample.hostNanoseconds;
+            }
+            if (fresh)
+            {
+                before = now;
+                now = sample;
+            }
+            attached = true;
+            display(name, reader, now, before, !running ? " [exited]" : fresh ? "" : " [paused]");
+        }
+        if (!running)
+            return 0;
+        this_thread::sleep_for(chrono::milliseconds(refresh));
+    }
+}
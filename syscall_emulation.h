@@ -0,0 +1,185 @@
+#ifndef SYSCALL_EMULATION_H
+#define SYSCALL_EMULATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Proxy-kernel emulation of the newlib system calls a bare-metal RV32
+// program makes through ecall: the number is in a7, arguments in a0-a2 and
+// the result is returned in a0 (negative errno on failure).
+enum SyscallNumber
+{
+    SYS_CLOSE = 57,
+    SYS_READ = 63,
+    SYS_WRITE = 64,
+    SYS_FSTAT = 80,
+    SYS_EXIT = 93,
+    SYS_EXIT_GROUP = 94,
+    SYS_CLOCK_GETTIME = 113,
+    SYS_BRK = 214
+};
+
+const int32_t SYSCALL_EBADF = -9;
+const int32_t SYSCALL_EFAULT = -14;
+const int32_t SYSCALL_ENOSYS = -38;
+
+const uint32_t ECALL_INSTRUCTION = 0x00000073;
+
+// Simulated core clock used to turn cycles into clock_gettime time.
+const uint64_t SIM_CLOCK_HZ = 100000000;
+
+// Guest output is collected and handed to the host in writes of this size.
+const size_t OUTPUT_FLUSH_BYTES = 65536;
+
+// brk() may grow data memory up to this many bytes.
+const uint32_t MAX_PROGRAM_BREAK = 64 * 1024 * 1024;
+
+// Layout of newlib's struct stat for RV32 (the pk kernel_stat).
+const uint32_t KERNEL_STAT_SIZE = 128;
+const uint32_t KERNEL_STAT_MODE_OFFSET = 16;
+const uint32_t KERNEL_STAT_S_IFCHR = 0020000;
+
+// Guest is the simulator-side adapter. It provides:
+//   int32_t readRegister(int reg), void writeRegister(int reg, int32_t value)
+//   bool loadByte(uint32_t address, uint8_t &value)
+//   bool storeByte(uint32_t address, uint8_t value)
+//   uint32_t getBreak(), bool setBreak(uint32_t address)
+//   uint64_t getCycles()
+//   void output(int fd, const char *data, size_t size)
+//   size_t input(char *data, size_t size)
+//   void exit(int32_t code)
+template <typename Guest>
+bool storeGuestWord(Guest &guest, uint32_t address, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (!guest.storeByte(address + i, (uint8_t)(value >> (8 * i))))
+            return false;
+    }
+    return true;
+}
+
+template <typename Guest>
+int32_t syscallWrite(Guest &guest, int32_t fd, uint32_t buffer, uint32_t length)
+{
+    if (fd != 1 && fd != 2)
+        return SYSCALL_EBADF;
+
+    char chunk[4096];
+    uint32_t written = 0;
+    while (written < length)
+    {
+        size_t count = 0;
+        while (count < sizeof(chunk) && written + count < length)
+        {
+            uint8_t byte;
+            if (!guest.loadByte(buffer + written + count, byte))
+                break;
+            chunk[count++] = (char)byte;
+        }
+        guest.output(fd, chunk, count);
+        written += count;
+        if (count < sizeof(chunk) && written < length)
+            return written > 0 ? (int32_t)written : SYSCALL_EFAULT;
+    }
+    return written;
+}
+
+template <typename Guest>
+int32_t syscallRead(Guest &guest, int32_t fd, uint32_t buffer, uint32_t length)
+{
+    if (fd != 0)
+        return SYSCALL_EBADF;
+
+    char chunk[4096];
+    uint32_t total = 0;
+    while (total < length)
+    {
+        size_t wanted = length - total < sizeof(chunk) ? length - total : sizeof(chunk);
+        size_t count = guest.input(chunk, wanted);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!guest.storeByte(buffer + total + i, (uint8_t)chunk[i]))
+                return SYSCALL_EFAULT;
+        }
+        total += count;
+        // Like a terminal read, return as soon as a line or EOF arrives.
+        if (count < wanted || (count > 0 && chunk[count - 1] == '\n'))
+            break;
+    }
+    return total;
+}
+
+template <typename Guest>
+int32_t syscallFstat(Guest &guest, int32_t fd, uint32_t statAddress)
+{
+    if (fd < 0 || fd > 2)
+        return SYSCALL_EBADF;
+
+    for (uint32_t i = 0; i < KERNEL_STAT_SIZE; i += 4)
+    {
+        uint32_t value = (i == KERNEL_STAT_MODE_OFFSET) ? KERNEL_STAT_S_IFCHR : 0;
+        if (!storeGuestWord(guest, statAddress + i, value))
+            return SYSCALL_EFAULT;
+    }
+    return 0;
+}
+
+template <typename Guest>
+int32_t syscallClockGettime(Guest &guest, uint32_t timespecAddress)
+{
+    uint64_t cycles = guest.getCycles();
+    uint64_t seconds = cycles / SIM_CLOCK_HZ;
+    uint32_t nanoseconds = (uint32_t)((cycles % SIM_CLOCK_HZ) * 1000000000ULL / SIM_CLOCK_HZ);
+
+    // RV32 newlib uses a 64-bit time_t followed by a 32-bit long.
+    if (!storeGuestWord(guest, timespecAddress, (uint32_t)seconds) ||
+        !storeGuestWord(guest, timespecAddress + 4, (uint32_t)(seconds >> 32)) ||
+        !storeGuestWord(guest, timespecAddress + 8, nanoseconds))
+        return SYSCALL_EFAULT;
+    return 0;
+}
+
+// Runs the system call described by the guest's registers. Returns false
+// when the program exited.
+template <typename Guest>
+bool emulateSyscall(Guest &guest)
+{
+    int32_t a0 = guest.readRegister(10);
+    int32_t a1 = guest.readRegister(11);
+    int32_t a2 = guest.readRegister(12);
+    int32_t result;
+
+    switch (guest.readRegister(17))
+    {
+    case SYS_WRITE:
+        result = syscallWrite(guest, a0, a1, a2);
+        break;
+    case SYS_READ:
+        result = syscallRead(guest, a0, a1, a2);
+        break;
+    case SYS_FSTAT:
+        result = syscallFstat(guest, a0, a1);
+        break;
+    case SYS_CLOSE:
+        result = (a0 >= 0 && a0 <= 2) ? 0 : SYSCALL_EBADF;
+        break;
+    case SYS_CLOCK_GETTIME:
+        result = syscallClockGettime(guest, a1);
+        break;
+    case SYS_BRK:
+        result = (a0 != 0 && guest.setBreak(a0)) ? a0 : guest.getBreak();
+        break;
+    case SYS_EXIT:
+    case SYS_EXIT_GROUP:
+        guest.exit(a0);
+        return false;
+    default:
+        result = SYSCALL_ENOSYS;
+    }
+
+    guest.writeRegister(10, result);
+    return true;
+}
+
+#endif
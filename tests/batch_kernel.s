@@ -0,0 +1,56 @@
+# Data-dependent kernel for batch_simulator_test, so lanes take different
+# branches. Data word 0 holds a count n and words 1..n the values: odd values
+# are added to x3, even values have their square subtracted. Then x3 is
+# divided by the odd count and taken modulo the (now zero) counter, covering
+# division by zero, and a jalr picks its target from x3. The nops let values
+# reach a beq/jalr, which read the register file without forwarding.
+
+        lw      x1, 0(x0)
+        addi    x2, x0, 4
+        addi    x3, x0, 0
+        addi    x6, x0, 0
+        addi    x14, x0, 1
+loop:
+        nop
+        nop
+        beq     x1, x0, done
+        lw      x4, 0(x2)
+        andi    x5, x4, 1
+        nop
+        nop
+        beq     x5, x0, even
+        add     x3, x3, x4
+        addi    x6, x6, 1
+        jal     x0, next
+even:
+        mul     x7, x4, x4
+        sub     x3, x3, x7
+        add     x3, x3, x8
+next:
+        addi    x2, x2, 4
+        sub     x1, x1, x14
+        jal     x0, loop
+done:
+        jal     x10, func
+        sw      x3, 100(x0)
+        sw      x8, 104(x0)
+        sw      x9, 108(x0)
+        andi    x12, x3, 4
+        addi    x13, x0, 0
+        jal     x11, here
+here:
+        add     x11, x11, x12
+        nop
+        nop
+        jalr    x0, 16(x11)         # skips the first addi when x3 & 4
+        addi    x13, x13, 7
+        addi    x13, x13, 9
+        sw      x13, 112(x0)
+        jal     x0, end
+func:
+        div     x8, x3, x6
+        rem     x9, x3, x1
+        nop
+        nop
+        jalr    x0, 0(x10)
+end:
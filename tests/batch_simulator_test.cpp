@@ -0,0 +1,159 @@
+#include "batch_simulator.h"
+#include "test_paths.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks that every BatchSimulator lane ends in exactly the state of a solo
+// RISCVSimulator run on the same data image, then times both over many
+// images of tests/batch_kernel.hex. Exits non-zero on any mismatch.
+
+static vector<int32_t> kernelImage(int count)
+{
+    vector<int32_t> image(1, count);
+    for (int i = 0; i < count; i++)
+        image.push_back(rand() % 2000 - 1000);
+    return image;
+}
+
+static vector<int32_t> programImage()
+{
+    vector<int32_t> image;
+    for (int i = 0; i < 8; i++)
+        image.push_back(rand() % 50);
+    return image;
+}
+
+static bool matchesSolo(const string &program, const BatchSimulator &batch, int lane, const vector<int32_t> &image)
+{
+    RISCVSimulator solo;
+    solo.loadProgram(program);
+    for (size_t i = 0; i < image.size(); i++)
+        solo.setDataWord(i, image[i]);
+    solo.step(INT_MAX);
+
+    if (solo.getTotalCycles() != batch.getTotalCycles(lane) ||
+        solo.getInstructionsCompleted() != batch.getInstructionsCompleted(lane) ||
+        solo.getIFUtilization() != batch.getIFUtilization(lane) ||
+        solo.getIDUtilization() != batch.getIDUtilization(lane) ||
+        solo.getEXUtilization() != batch.getEXUtilization(lane) ||
+        solo.getMEMUtilization() != batch.getMEMUtilization(lane) ||
+        solo.getWBUtilization() != batch.getWBUtilization(lane))
+        return false;
+
+    for (int reg = 0; reg < 32; reg++)
+    {
+        if (solo.getRegisters()[reg] != batch.getRegister(lane, reg))
+            return false;
+    }
+
+    if (solo.getDataMemory().size() != batch.getDataMemorySize())
+        return false;
+    for (size_t i = 0; i < batch.getDataMemorySize(); i++)
+    {
+        if (solo.getDataMemory()[i] != batch.getDataWord(lane, i))
+            return false;
+    }
+    return true;
+}
+
+static int checkProgram(const string &program, bool useKernelImages)
+{
+    int failures = 0;
+    for (int trial = 0; trial < 50; trial++)
+    {
+        BatchSimulator batch;
+        if (!batch.loadProgram(program))
+        {
+            cerr << "Error: Could not load " << program << endl;
+            return 1;
+        }
+
+        int lanes = 1 + rand() % BatchSimulator::LANES;
+        batch.reset(lanes);
+        vector<vector<int32_t> > images(lanes);
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            images[lane] = useKernelImages ? kernelImage(rand() % 13) : programImage();
+            batch.setDataMemory(lane, Span<int32_t>(images[lane].data(), images[lane].size()));
+        }
+        batch.run(INT_MAX);
+
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            if (!matchesSolo(program, batch, lane, images[lane]))
+            {
+                cout << "FAIL " << program << " trial " << trial << " lane " << lane << endl;
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+static void measureThroughput(const string &program)
+{
+    // Equal counts, so lanes only diverge on the odd/even test.
+    const int IMAGES = 65536;
+    vector<vector<int32_t> > images(IMAGES);
+    for (int i = 0; i < IMAGES; i++)
+        images[i] = kernelImage(10);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    RISCVSimulator prototype;
+    prototype.loadProgram(program);
+    for (int i = 0; i < IMAGES; i++)
+    {
+        RISCVSimulator solo = prototype;
+        for (size_t k = 0; k < images[i].size(); k++)
+            solo.setDataWord(k, images[i][k]);
+        solo.step(INT_MAX);
+    }
+
+    chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+    BatchSimulator batch;
+    batch.loadProgram(program);
+    double efficiency = 0;
+    for (int i = 0; i < IMAGES; i += BatchSimulator::LANES)
+    {
+        batch.reset();
+        for (int lane = 0; lane < BatchSimulator::LANES; lane++)
+            batch.setDataMemory(lane, Span<int32_t>(images[i + lane].data(), images[i + lane].size()));
+        batch.run(INT_MAX);
+        efficiency += batch.getLockstepEfficiency();
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    double soloSeconds = chrono::duration<double>(middle - start).count();
+    double batchSeconds = chrono::duration<double>(end - middle).count();
+    cout << fixed << setprecision(3) << IMAGES << " images: solo " << soloSeconds << "s, batch " << batchSeconds
+         << "s, speedup " << setprecision(2) << soloSeconds / batchSeconds << "x, lockstep efficiency "
+         << efficiency / (IMAGES / BatchSimulator::LANES) << endl;
+}
+
+int main()
+{
+    srand(7);
+
+    int failures = checkProgram(sourcePath("tests/batch_kernel.hex"), true);
+    const char *programs[] = {"test.hex", "fibonacci.hex", "gcd.hex", "binary_search.hex"};
+    for (int i = 0; i < 4; i++)
+        failures += checkProgram(sourcePath(programs[i]), false);
+
+    if (failures > 0)
+    {
+        cout << failures << " lanes differ from a solo run" << endl;
+        return 1;
+    }
+    cout << "All lanes match their solo runs" << endl;
+
+    measureThroughput(sourcePath("tests/batch_kernel.hex"));
+    return 0;
+}
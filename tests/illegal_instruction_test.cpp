@@ -0,0 +1,71 @@
+#include "batch_simulator.h"
+#include "riscv_simulator.h"
+#include "test_paths.h"
+
+#include <climits>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Checks that a compressed instruction EX cannot run (tests/illegal_compressed.hex
+// has c.bnez at PC 16, and another on the path a jal skips) stops the
+// simulation with an illegal-instruction fault at its PC instead of retiring
+// as a nop, in solo and batched runs. Exits non-zero on any failure.
+
+static int check(bool condition, const char *what)
+{
+    if (condition)
+        return 0;
+    cout << "FAIL " << what << endl;
+    return 1;
+}
+
+int main()
+{
+    string program = sourcePath("tests/illegal_compressed.hex");
+
+    RISCVSimulator sim;
+    if (!sim.loadProgram(program))
+    {
+        cerr << "Error: Could not load " << program << endl;
+        return 1;
+    }
+
+    int failures = 0;
+    StopReason reason = sim.runUntilStop(1000);
+    failures += check(reason == STOP_ILLEGAL, "runUntilStop reports STOP_ILLEGAL");
+    failures += check(sim.getStopAddress() == 16, "stop address is the faulting PC");
+    failures += check(sim.hasFaulted() && sim.getFaultPC() == 16, "fault PC is recorded");
+    failures += check(!sim.hasExited(), "a fault is not an exit");
+    failures += check(sim.isProgramComplete(), "a faulted program is complete");
+    failures += check(sim.getRegisters()[1] == 5 && sim.getRegisters()[2] == 1, "older instructions retire");
+    failures += check(sim.getRegisters()[3] == 0, "younger instructions do not retire");
+    failures += check(sim.getInstructionsCompleted() == 3, "the illegal instruction does not retire");
+    failures += check(sim.runUntilStop(1000) == STOP_COMPLETE, "a faulted program does not resume");
+
+    sim.reset();
+    sim.step(INT_MAX);
+    failures += check(sim.hasFaulted() && sim.getFaultPC() == 16, "step() stops at the fault");
+
+    BatchSimulator batch;
+    batch.loadProgram(program);
+    batch.reset(2);
+    batch.run(INT_MAX);
+    for (int lane = 0; lane < 2; lane++)
+    {
+        failures += check(batch.hasFaulted(lane) && !batch.hasExited(lane), "batch lane faults");
+        failures += check(batch.getTotalCycles(lane) == sim.getTotalCycles() &&
+                              batch.getInstructionsCompleted(lane) == sim.getInstructionsCompleted() &&
+                              batch.getMEMUtilization(lane) == sim.getMEMUtilization(),
+                          "batch lane matches the solo run");
+    }
+
+    if (failures > 0)
+    {
+        cout << failures << " illegal instruction checks failed" << endl;
+        return 1;
+    }
+    cout << "Illegal instructions are reported" << endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "riscv_simulator.h"
+#include "test_paths.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks program loading: hex lines with trailing comments and joined digit
+// groups, that a new load starts from clean data memory and pipeline state,
+// and that program images with a bad entry PC or section are rejected
+// without disturbing the loaded program. Exits non-zero on any failure.
+
+static int check(bool condition, const char *what)
+{
+    if (condition)
+        return 0;
+    cout << "FAIL " << what << endl;
+    return 1;
+}
+
+static void writeFile(const string &name, const string &contents)
+{
+    ofstream file(name.c_str(), ios::binary);
+    file << contents;
+}
+
+static string readFile(const string &name)
+{
+    ifstream file(name.c_str(), ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+static int checkHexLines()
+{
+    writeFile("load_test.hex", "# comment line\n"
+                               "00500093    # addi x1, x0, 5\n"
+                               "00a00113\t# addi x2, x0, 10\n"
+                               "\n"
+                               "  0x00300193\n"
+                               "0050 0213\n"
+                               "00500093 1\n"
+                               "00600293");
+
+    RISCVSimulator sim;
+    int failures = check(sim.loadProgram("load_test.hex"), "hex file loads");
+    Span<uint32_t> text = sim.getInstructionMemory();
+    failures += check(text[0] == 0x00500093, "space and comment after eight digits");
+    failures += check(text[1] == 0x00a00113, "tab and comment after eight digits");
+    failures += check(text[2] == 0x00300193, "indented 0x-prefixed word");
+    failures += check(text[3] == 0x00500213, "spaces join digit groups");
+    failures += check(text[4] == 0x05000931, "a digit after spaces continues the word");
+    failures += check(text[5] == 0x00600293, "word at the end of the file");
+    failures += check(text[6] == 0, "blank and comment lines are skipped");
+    remove("load_test.hex");
+    return failures;
+}
+
+static int checkReloadClearsState()
+{
+    RISCVSimulator sim;
+    sim.loadProgram(sourcePath("fibonacci.hex"));
+    sim.setDataWord(600, 7);
+    sim.step(20);
+
+    int failures = check(sim.loadProgram(sourcePath("test.hex")), "second program loads");
+    Span<int32_t> data = sim.getDataMemory();
+    bool clean = data.size() == 512;
+    for (size_t i = 0; i < data.size(); i++)
+        clean = clean && data[i] == 0;
+    failures += check(clean, "data memory is cleared on load");
+    failures += check(sim.getTotalCycles() == 0 && sim.getInstructionsCompleted() == 0 && sim.getPC() == 0,
+                      "pipeline state is reset on load");
+    failures += check(!sim.getIFID().valid && !sim.getMEMWB().valid, "latches are cleared on load");
+    return failures;
+}
+
+static int checkImageEntryPC()
+{
+    RISCVSimulator writer;
+    writer.loadProgram(sourcePath("gcd.hex"));
+    writer.saveImage("load_test.rvb");
+    string image = readFile("load_test.rvb");
+    remove("load_test.rvb");
+
+    const size_t ENTRY_OFFSET = 8; // magic, version, section count
+    const uint32_t entries[] = {1, 0x1000, 0xFFFFFFFE, 6};
+    const bool valid[] = {false, false, false, true};
+
+    RISCVSimulator sim;
+    sim.loadProgram(sourcePath("fibonacci.hex"));
+    vector<uint32_t> loaded(sim.getInstructionMemory().begin(), sim.getInstructionMemory().end());
+
+    int failures = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        string patched = image;
+        memcpy(&patched[ENTRY_OFFSET], &entries[i], sizeof(entries[i]));
+        writeFile("load_test.rvb", patched);
+        bool ok = sim.loadProgram("load_test.rvb");
+        failures += check(ok == valid[i], valid[i] ? "aligned entry PC in the text is accepted"
+                                                   : "misaligned or out-of-range entry PC is rejected");
+        if (!ok)
+            failures += check(vector<uint32_t>(sim.getInstructionMemory().begin(), sim.getInstructionMemory().end()) ==
+                                  loaded,
+                              "a rejected image leaves the program loaded");
+        else
+            failures += check(sim.getPC() == entries[i], "execution starts at the entry PC");
+    }
+
+    // A section running past the end of the file.
+    writeFile("load_test.rvb", image.substr(0, image.size() - 4));
+    failures += check(!sim.loadProgram("load_test.rvb"), "truncated section is rejected");
+    remove("load_test.rvb");
+    return failures;
+}
+
+int main()
+{
+    int failures = checkHexLines() + checkReloadClearsState() + checkImageEntryPC();
+
+    if (failures > 0)
+    {
+        cout << failures << " load checks failed" << endl;
+        return 1;
+    }
+    cout << "Programs load as expected" << endl;
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "riscv_simulator.h"
+#include "test_paths.h"
+
+#include <climits>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks reverse execution against forward runs: reverseContinue() must stop
+// at exactly the cycles runUntilStop() stopped at, in reverse order, with and
+// without DRAM timing (whose stall cycles freeze the pipeline), and the
+// sampler must keep running every interval cycles across a rewind. Exits
+// non-zero on any difference.
+
+struct Stop
+{
+    int64_t cycle;
+    StopReason reason;
+
+    bool operator==(const Stop &other) const { return cycle == other.cycle && reason == other.reason; }
+};
+
+class StoreRecorder : public SimObserver
+{
+public:
+    vector<uint32_t> addresses;
+
+    void onMemoryAccess(int64_t, uint64_t, uint32_t address, int32_t, bool isWrite)
+    {
+        if (isWrite)
+            addresses.push_back(address);
+    }
+};
+
+class SampleRecorder : public SimObserver
+{
+public:
+    vector<int64_t> cycles;
+
+    void onCycleEnd(const RISCVSimulator &sim) { cycles.push_back(sim.getTotalCycles()); }
+};
+
+static bool load(RISCVSimulator &sim, const string &program, const string &dram)
+{
+    if (!dram.empty())
+    {
+        DramConfig config;
+        if (!parseDramConfig(dram, config) || !sim.configureDram(config))
+            return false;
+    }
+    return sim.loadProgram(program);
+}
+
+static int checkReverseContinue(const string &program, const string &dram)
+{
+    // Watch every word the program stores to.
+    RISCVSimulator probe;
+    StoreRecorder stores;
+    probe.addObserver(&stores);
+    if (!load(probe, program, dram))
+    {
+        cerr << "Error: Could not load " << program << endl;
+        return 1;
+    }
+    probe.step(INT_MAX);
+
+    RISCVSimulator sim;
+    load(sim, program, dram);
+    sim.enableHistory(1000000);
+    for (uint32_t pc = 0; pc < 64; pc += 12)
+        sim.addBreakpoint(pc);
+    for (size_t i = 0; i < stores.addresses.size(); i += 3)
+        sim.addWatchpoint(stores.addresses[i]);
+
+    vector<Stop> forward;
+    for (;;)
+    {
+        StopReason reason = sim.runUntilStop(INT_MAX);
+        if (reason == STOP_COMPLETE || reason == STOP_LIMIT)
+            break;
+        Stop stop = {sim.getTotalCycles(), reason};
+        forward.push_back(stop);
+    }
+
+    vector<Stop> backward;
+    for (;;)
+    {
+        StopReason reason = sim.reverseContinue();
+        if (reason == STOP_LIMIT)
+            break;
+        Stop stop = {sim.getTotalCycles(), reason};
+        backward.push_back(stop);
+    }
+
+    vector<Stop> expected(forward.rbegin(), forward.rend());
+    if (forward.size() < 2 || backward != expected)
+    {
+        cout << "FAIL reverse-continue " << program << (dram.empty() ? "" : " with DRAM " + dram) << ": "
+             << forward.size() << " stops forward, " << backward.size() << " backward" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int checkSamplerAcrossRewind(const string &program)
+{
+    RISCVSimulator sim;
+    SampleRecorder sampler;
+    load(sim, program, "");
+    sim.enableHistory(1000000);
+    sim.setSampler(&sampler, 10);
+
+    // fibonacci.hex runs 91 cycles: forward to the end, back to cycle 56 and
+    // forward again.
+    sim.step(INT_MAX);
+    for (int i = 0; i < 35; i++)
+        sim.reverseCycle();
+    sim.step(INT_MAX);
+
+    const int64_t expected[] = {10, 20, 30, 40, 50, 60, 70, 80, 90, 80, 70, 60, 70, 80, 90};
+    if (sampler.cycles != vector<int64_t>(expected, expected + sizeof(expected) / sizeof(expected[0])))
+    {
+        cout << "FAIL sampler across a rewind " << program << ": " << sampler.cycles.size() << " samples" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    const char *programs[] = {"fibonacci.hex", "gcd.hex", "binary_search.hex"};
+    const char *drams[] = {"", "banks=8", "channels=2,banks=4,policy=closed"};
+
+    int failures = 0;
+    for (int p = 0; p < 3; p++)
+    {
+        for (int d = 0; d < 3; d++)
+            failures += checkReverseContinue(sourcePath(programs[p]), drams[d]);
+    }
+    failures += checkSamplerAcrossRewind(sourcePath("fibonacci.hex"));
+
+    if (failures > 0)
+    {
+        cout << failures << " reverse execution checks failed" << endl;
+        return 1;
+    }
+    cout << "Reverse execution matches forward runs" << endl;
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef TEST_PATHS_H
+#define TEST_PATHS_H
+
+#include <string>
+
+// Root of the source tree, where the bundled programs live. The build passes
+// it in (-DRISCV_SIM_SOURCE_DIR=...) so the tests can run from any directory.
+#ifndef RISCV_SIM_SOURCE_DIR
+#define RISCV_SIM_SOURCE_DIR "."
+#endif
+
+inline std::string sourcePath(const std::string &name)
+{
+    return std::string(RISCV_SIM_SOURCE_DIR) + "/" + name;
+}
+
+#endif
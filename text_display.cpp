@@ -0,0 +1,336 @@
+#include "text_display.h"
+#include "riscv_simulator.h"
+
+#include <iomanip>
+
+using namespace std;
+
+int TextBuffer::overflow(int c)
+{
+    if (c != EOF)
+        text.push_back((char)c);
+    return c;
+}
+
+streamsize TextBuffer::xsputn(const char *s, streamsize n)
+{
+    text.append(s, n);
+    return n;
+}
+
+TextDisplay::TextDisplay(ostream &sink)
+    : sink(sink), out(&buffer)
+{
+}
+
+void TextDisplay::flush()
+{
+    sink.write(buffer.text.data(), buffer.text.size());
+    buffer.text.clear();
+}
+
+void TextDisplay::displayState(const RISCVSimulator &sim)
+{
+    const IF_ID &if_id = sim.getIFID();
+    const ID_EX &id_ex = sim.getIDEX();
+    const EX_MEM &ex_mem = sim.getEXMEM();
+    const MEM_WB &mem_wb = sim.getMEMWB();
+    Span<int32_t> registers = sim.getRegisters();
+    uint32_t PC = sim.getPC();
+    int64_t totalCycles = sim.getTotalCycles();
+    bool stall = sim.isStalled();
+
+    out << "\n========== Cycle " << totalCycles << " ==========\n";
+
+    out << "\n--- Pipeline Registers ---\n";
+    out << "IF/ID:  Valid=" << if_id.valid << " IR=0x" << hex << setw(8) << setfill('0') << if_id.IR
+         << " NPC=" << dec << if_id.NPC << "\n";
+    out << "ID/EX:  Valid=" << id_ex.valid << " IR=0x" << hex << setw(8) << setfill('0') << id_ex.IR
+         << " A=" << dec << id_ex.A << " B=" << id_ex.B << " Imm=" << id_ex.Imm << "\n";
+    out << "EX/MEM: Valid=" << ex_mem.valid << " IR=0x" << hex << setw(8) << setfill('0') << ex_mem.IR
+         << " ALUOutput=" << dec << ex_mem.ALUOutput << " B=" << ex_mem.B << " cond=" << ex_mem.cond << "\n";
+    out << "MEM/WB: Valid=" << mem_wb.valid << " IR=0x" << hex << setw(8) << setfill('0') << mem_wb.IR
+         << " ALUOutput=" << dec << mem_wb.ALUOutput << " LMD=" << mem_wb.LMD << "\n";
+
+    out << "\n--- Registers ---\n";
+    for (int i = 0; i < 32; i += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            int reg = i + j;
+            out << "x" << setw(2) << setfill('0') << reg << "(" << setw(5) << setfill(' ') << left
+                 << RISCVSimulator::getRegisterName(reg) << ")" << right << "=" << registers[reg] << setw(10);
+            if (j < 3)
+                out << " ";
+        }
+        out << "\n";
+    }
+
+    out << "\nPC = " << PC << " (0x" << hex << PC << dec << ")\n";
+    out << "Stall = " << (stall ? "YES" : "NO") << "\n";
+    flush();
+}
+
+void TextDisplay::displayMemory(const RISCVSimulator &sim, int start, int count, bool isData)
+{
+    Span<uint32_t> instructionMemory = sim.getInstructionMemory();
+    Span<int32_t> dataMemory = sim.getDataMemory();
+
+    out << "\n========== " << (isData ? "Data" : "Instruction") << " Memory ==========\n";
+    out << "Showing " << count << " words starting from address " << start << " (0x" << hex << start << dec << ")\n\n";
+
+    for (int i = 0; i < count; i++)
+    {
+        int addr = start + (i * 4);
+        int index = addr / 4;
+
+        if (isData && index < dataMemory.size())
+        {
+            out << "Address 0x" << hex << setw(4) << setfill('0') << addr << dec
+                 << " [" << setw(4) << index << "]: "
+                 << setw(10) << dataMemory[index] << " (0x" << hex << setw(8) << setfill('0')
+                 << (uint32_t)dataMemory[index] << dec << ")\n";
+        }
+        else if (!isData && index < instructionMemory.size())
+        {
+            out << "Address 0x" << hex << setw(4) << setfill('0') << addr << dec
+                 << " [" << setw(4) << index << "]: "
+                 << "0x" << hex << setw(8) << setfill('0') << instructionMemory[index] << dec << "\n";
+        }
+    }
+    out << "\n";
+    flush();
+}
+
+void TextDisplay::displayPipelineVisualization(const RISCVSimulator &sim)
+{
+    const IF_ID &if_id = sim.getIFID();
+    const ID_EX &id_ex = sim.getIDEX();
+    const EX_MEM &ex_mem = sim.getEXMEM();
+    const MEM_WB &mem_wb = sim.getMEMWB();
+    Span<uint32_t> instructionMemory = sim.getInstructionMemory();
+    uint32_t PC = sim.getPC();
+    int64_t totalCycles = sim.getTotalCycles();
+
+    out << "\n======================================================================\n";
+    out << "|                    PIPELINE VISUALIZATION                            |\n";
+    out << "======================================================================\n\n";
+
+    out << "   ---------      ---------      ---------      ---------      ---------\n";
+    out << "  |   IF    |--->|   ID    |--->|   EX    |--->|   MEM   |--->|   WB    |\n";
+    out << "  |  Fetch  |    | Decode  |    | Execute |    | Memory  |    |  Write  |\n";
+    out << "   ---------      ---------      ---------      ---------      --------\n\n";
+
+    out << "Current Pipeline State (Cycle " << totalCycles << "):\n\n";
+
+    out << "+- IF Stage ----------------------------------------------------+\n";
+    uint16_t parcel = readParcel(instructionMemory.data(), instructionMemory.size(), PC);
+    if (parcel != 0)
+    {
+        out << "|  Fetching from PC=" << PC << " (0x" << hex << PC << dec << ")\n";
+        if (isCompressed(parcel))
+            out << "|  Instruction: 0x" << hex << setw(4) << setfill('0') << parcel << dec << " (compressed)\n";
+        else
+            out << "|  Instruction: 0x" << hex << setw(8) << setfill('0')
+                 << ((uint32_t)readParcel(instructionMemory.data(), instructionMemory.size(), PC + 2) << 16 | parcel)
+                 << dec << "\n";
+    }
+    else
+    {
+        out << "|  [EMPTY - No instruction to fetch]\n";
+    }
+    out << "+---------------------------------------------------------------+\n\n";
+
+    out << "+- ID Stage (IF/ID Latch) -------------------------------------+\n";
+    if (if_id.valid)
+    {
+        out << "|  IR:  0x" << hex << setw(8) << setfill('0') << if_id.IR << dec << "\n";
+        out << "|  NPC: " << if_id.NPC << "\n";
+        out << "|  Status: Decoding instruction\n";
+    }
+    else
+    {
+        out << "|  [BUBBLE - No valid instruction]\n";
+    }
+    out << "+---------------------------------------------------------------+\n\n";
+
+    out << "+- EX Stage (ID/EX Latch) -------------------------------------+\n";
+    if (id_ex.valid)
+    {
+        out << "|  IR:  0x" << hex << setw(8) << setfill('0') << id_ex.IR << dec << "\n";
+        out << "|  A:   " << id_ex.A << "\n";
+        out << "|  B:   " << id_ex.B << "\n";
+        out << "|  Imm: " << id_ex.Imm << "\n";
+        out << "|  Status: Executing ALU operation\n";
+    }
+    else
+    {
+        out << "|  [BUBBLE - No valid instruction]\n";
+    }
+    out << "+---------------------------------------------------------------+\n\n";
+
+    out << "+- MEM Stage (EX/MEM Latch) -----------------------------------+\n";
+    if (ex_mem.valid)
+    {
+        out << "|  IR:        0x" << hex << setw(8) << setfill('0') << ex_mem.IR << dec << "\n";
+        out << "|  ALUOutput: " << ex_mem.ALUOutput << "\n";
+        out << "|  B:         " << ex_mem.B << "\n";
+        out << "|  Cond:      " << (ex_mem.cond ? "TRUE" : "FALSE") << "\n";
+        out << "|  Status: Accessing memory (if needed)\n";
+    }
+    else
+    {
+        out << "|  [BUBBLE - No valid instruction]\n";
+    }
+    out << "+---------------------------------------------------------------+\n\n";
+
+    out << "+- WB Stage (MEM/WB Latch) ------------------------------------+\n";
+    if (mem_wb.valid)
+    {
+        out << "|  IR:        0x" << hex << setw(8) << setfill('0') << mem_wb.IR << dec << "\n";
+        out << "|  ALUOutput: " << mem_wb.ALUOutput << "\n";
+        out << "|  LMD:       " << mem_wb.LMD << "\n";
+        uint32_t rd = (mem_wb.IR >> 7) & 0x1F;
+        out << "|  Writing to: x" << rd;
+        if (rd > 0)
+            out << " (" << RISCVSimulator::getRegisterName(rd) << ")";
+        out << "\n";
+        out << "|  Status: Writing back to register\n";
+    }
+    else
+    {
+        out << "|  [BUBBLE - No valid instruction]\n";
+    }
+    out << "+---------------------------------------------------------------+\n\n";
+
+    // Show hazards
+    if (sim.isStalled())
+    {
+        out << "*** HAZARD DETECTED: Pipeline stalled due to data hazard ***\n";
+    }
+    if (sim.isFlushing())
+    {
+        out << "*** CONTROL HAZARD: Branch/Jump detected, flushing pipeline ***\n";
+    }
+
+    out << "\n";
+    flush();
+}
+
+void TextDisplay::displayStatistics(const RISCVSimulator &sim)
+{
+    int64_t totalCycles = sim.getTotalCycles();
+    int64_t if_utilization = sim.getIFUtilization();
+    int64_t id_utilization = sim.getIDUtilization();
+    int64_t ex_utilization = sim.getEXUtilization();
+    int64_t mem_utilization = sim.getMEMUtilization();
+    int64_t wb_utilization = sim.getWBUtilization();
+
+    out << "\n========== Execution Statistics ==========\n";
+    out << "Total Cycles: " << totalCycles << "\n";
+    out << "Instructions Completed: " << sim.getInstructionsCompleted() << "\n";
+    out << "Hazard Stall Cycles: " << sim.getHazardStallCycles() << "\n";
+    out << "Flushed Instructions: " << sim.getFlushedInstructions() << "\n";
+    if (sim.hasExited())
+        out << "Exit Code: " << sim.getExitCode() << "\n";
+    if (sim.hasFaulted())
+        out << "Illegal Instruction at PC=" << sim.getFaultPC() << " (0x" << hex << sim.getFaultPC() << dec << ")\n";
+
+    out << "\nStage Utilization:\n";
+    out << "  IF:  " << if_utilization << " / " << totalCycles
+         << " = " << fixed << setprecision(2) << (100.0 * if_utilization / totalCycles) << "%\n";
+    out << "  ID:  " << id_utilization << " / " << totalCycles
+         << " = " << (100.0 * id_utilization / totalCycles) << "%\n";
+    out << "  EX:  " << ex_utilization << " / " << totalCycles
+         << " = " << (100.0 * ex_utilization / totalCycles) << "%\n";
+    out << "  MEM: " << mem_utilization << " / " << totalCycles
+         << " = " << (100.0 * mem_utilization / totalCycles) << "%\n";
+    out << "  WB:  " << wb_utilization << " / " << totalCycles
+         << " = " << (100.0 * wb_utilization / totalCycles) << "%\n";
+
+    // Savings are measured against the same instructions at 4 bytes each.
+    int compressed = sim.getStaticCompressedCount();
+    if (compressed > 0)
+    {
+        int instructions = sim.getStaticInstructionCount();
+        int codeBytes = 4 * instructions - 2 * compressed;
+        out << "\nCode Density:\n";
+        out << "  Instructions: " << instructions << " (" << compressed << " compressed)\n";
+        out << "  Code Size: " << codeBytes << " bytes vs " << 4 * instructions
+             << " uncompressed = " << (100.0 - 100.0 * codeBytes / (4 * instructions)) << "% smaller\n";
+
+        int64_t fetched = sim.getFetchedInstructions();
+        int64_t fetchBytes = 4 * fetched - 2 * sim.getFetchedCompressed();
+        out << "\nFetch Bandwidth:\n";
+        out << "  Instructions Fetched: " << fetched << " (" << sim.getFetchedCompressed() << " compressed)\n";
+        out << "  Block Reads: " << sim.getFetchBlockReads() << " x " << FetchBuffer::BLOCK_BYTES << " bytes\n";
+        if (fetched > 0)
+            out << "  Fetched Bytes: " << fetchBytes << " vs " << 4 * fetched
+                 << " uncompressed = " << (100.0 - 100.0 * fetchBytes / (4 * fetched)) << "% fewer\n";
+    }
+
+    const DramModel &dram = sim.getDram();
+    if (dram.isEnabled())
+    {
+        out << "\nDRAM:\n";
+        out << "  Requests: " << dram.getRequests() << "\n";
+        out << "  Row Hit Rate: " << 100.0 * dram.getRowHitRate() << "% (" << dram.getRowHits()
+             << " hits, " << dram.getRowMisses() << " misses, " << dram.getBankConflicts() << " bank conflicts)\n";
+        out << "  Average Latency: " << dram.getAverageLatency() << " cycles\n";
+        out << "  Memory Stall Cycles: " << sim.getMemoryStallCycles() << "\n";
+
+        displayPrefetcher("Instruction", sim.getInstructionPrefetcher(), sim.getInstructionPrefetches());
+        displayPrefetcher("Data", sim.getDataPrefetcher(), sim.getDataPrefetches());
+    }
+    flush();
+}
+
+void TextDisplay::displayPrefetcher(const char *stream, const Prefetcher *prefetcher, const PrefetchBuffer &buffer)
+{
+    if (!prefetcher)
+        return;
+
+    out << "\n" << stream << " Prefetcher (" << prefetcher->getName() << "):\n";
+    out << "  Issued: " << buffer.getIssued() << " lines (" << buffer.getDropped() << " dropped)\n";
+    out << "  Coverage: " << 100.0 * buffer.getCoverage() << "% (" << buffer.getHits() << " of "
+         << buffer.getHits() + buffer.getMisses() << " accesses)\n";
+    out << "  Accuracy: " << 100.0 * buffer.getAccuracy() << "% (" << buffer.getUseful() << " lines used)\n";
+    out << "  Timeliness: " << 100.0 * buffer.getTimeliness() << "% (" << buffer.getLateHits() << " late)\n";
+}
+
+void TextDisplay::displayStopReason(const RISCVSimulator &sim)
+{
+    out << "\n*** ";
+    switch (sim.getStopReason())
+    {
+    case STOP_BREAKPOINT:
+        out << "Breakpoint hit at PC=" << sim.getStopAddress() << " (0x" << hex << sim.getStopAddress() << dec << ")";
+        break;
+    case STOP_WATCHPOINT:
+        out << "Watchpoint hit: store to address " << sim.getStopAddress() << " (0x" << hex << sim.getStopAddress() << dec << ")";
+        break;
+    case STOP_REGISTER:
+        out << "Register condition met";
+        break;
+    case STOP_CYCLES:
+        out << "Cycle condition met";
+        break;
+    case STOP_INSTRUCTIONS:
+        out << "Instruction count condition met";
+        break;
+    case STOP_ILLEGAL:
+        out << "Illegal instruction at PC=" << sim.getStopAddress() << " (0x" << hex << sim.getStopAddress() << dec << ")";
+        break;
+    case STOP_COMPLETE:
+        out << "Program completed";
+        break;
+    case STOP_LIMIT:
+        out << "Stopped without reaching a breakpoint or condition";
+        break;
+    default:
+        out << "Stopped";
+        break;
+    }
+    out << " ***\n";
+    flush();
+}
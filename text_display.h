@@ -0,0 +1,46 @@
+#ifndef TEXT_DISPLAY_H
+#define TEXT_DISPLAY_H
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+class RISCVSimulator;
+class Prefetcher;
+class PrefetchBuffer;
+
+// Stream buffer that appends into a std::string whose capacity is kept
+// between renders, so formatting does not reallocate once warmed up.
+class TextBuffer : public std::streambuf
+{
+public:
+    std::string text;
+
+protected:
+    int overflow(int c);
+    std::streamsize xsputn(const char *s, std::streamsize n);
+};
+
+// Console views of the simulator. The views are only formatted when one of
+// the display methods is called.
+class TextDisplay
+{
+public:
+    explicit TextDisplay(std::ostream &sink = std::cout);
+
+    void displayState(const RISCVSimulator &sim);
+    void displayMemory(const RISCVSimulator &sim, int start, int count, bool isData);
+    void displayPipelineVisualization(const RISCVSimulator &sim);
+    void displayStatistics(const RISCVSimulator &sim);
+    void displayStopReason(const RISCVSimulator &sim);
+
+private:
+    std::ostream &sink;
+    TextBuffer buffer;
+    std::ostream out;
+
+    void flush();
+    void displayPrefetcher(const char *stream, const Prefetcher *prefetcher, const PrefetchBuffer &buffer);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef UNDO_JOURNAL_H
+#define UNDO_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fetch_unit.h"
+
+// Pipeline control state, captured into one struct so that the journal can
+// diff it in blocks like the latches and timing state.
+struct ScalarState
+{
+    uint32_t PC;
+    uint32_t branch_target;
+    int64_t totalCycles;
+    int64_t if_utilization, id_utilization, ex_utilization, mem_utilization, wb_utilization;
+    int64_t instructionsCompleted;
+    int64_t hazardStallCycles;
+    int64_t flushedInstructions;
+    uint64_t nextSeq;
+    bool stall;
+    bool branch_taken;
+    bool squash_if_id;
+    bool flushed;
+    bool trapPending;
+    bool exited;
+    int32_t exitCode;
+    bool faulted;
+    uint32_t faultPC;
+    uint32_t programBreak;
+    uint32_t inputOffset;
+    uint32_t outputOffset;
+    FetchBuffer fetchBuffer;
+    uint32_t fetchLength;
+    int64_t fetchBlockReads;
+    int64_t fetchedInstructions;
+    int64_t fetchedCompressed;
+    int fetchRequest;
+    int memoryRequest;
+    int fetchLine;
+    int memoryLine;
+    uint64_t memoryReady;
+    int64_t memoryStallCycles;
+};
+
+struct RegisterWrite
+{
+    uint8_t reg;
+    int32_t oldValue;
+};
+
+struct MemoryWrite
+{
+    uint32_t index;
+    int32_t oldValue;
+};
+
+// Largest pipeline latch (current or _next copy) saved as raw bytes.
+const size_t MAX_LATCH_SIZE = 48;
+
+// Previous contents of size bytes at begin in one region of raw state (the
+// scalar state, a latch, the DRAM model, a prefetch buffer or prefetcher
+// table). Regions are compared in BLOCK_SIZE pieces, so a delta only covers
+// the counters, latch fields, queue entries or lines that changed; its bytes
+// follow those of the cycle's earlier deltas in blockBytes. Regions are at
+// most MAX_REGION_SIZE bytes, so offsets fit in 16 bits.
+struct BlockDelta
+{
+    static const size_t BLOCK_SIZE = 8;
+    static const size_t MAX_REGION_SIZE = 0xFFFF;
+
+    uint16_t begin;
+    uint16_t size;
+    uint8_t region;
+};
+
+// One simulated cycle: where its register, memory and block deltas start in
+// the journal arrays, and whether it was spent waiting for DRAM.
+struct CycleRecord
+{
+    size_t registerBegin;
+    size_t memoryBegin;
+    size_t blockBegin;
+    size_t bytesBegin;
+    bool frozen;
+};
+
+struct Checkpoint
+{
+    ScalarState scalars;
+    int32_t registers[32];
+    std::vector<int32_t> dataMemory;
+    unsigned char latches[8][MAX_LATCH_SIZE];
+    std::vector<unsigned char> timing;
+};
+
+// Undo log for reverse execution. Each cycle appends only what it changed.
+// Old cycles are discarded once maxCycles is exceeded; checkpoints taken every
+// checkpointInterval cycles let the simulator replay back into that range, so
+// only the newest checkpoint at or before the oldest record is kept with it.
+class UndoJournal
+{
+public:
+    UndoJournal() : enabled(false), maxCycles(100000), checkpointInterval(10000) {}
+
+    bool enabled;
+    size_t maxCycles;
+    int checkpointInterval;
+
+    std::vector<CycleRecord> cycles;
+    std::vector<RegisterWrite> registerWrites;
+    std::vector<MemoryWrite> memoryWrites;
+    std::vector<BlockDelta> blockDeltas;
+    std::vector<unsigned char> blockBytes;
+    std::vector<Checkpoint> checkpoints;
+
+    void clear()
+    {
+        clearCycles();
+        checkpoints.clear();
+    }
+
+    void clearCycles()
+    {
+        cycles.clear();
+        registerWrites.clear();
+        memoryWrites.clear();
+        blockDeltas.clear();
+        blockBytes.clear();
+    }
+
+    // Drops the oldest half of the cycle records, their deltas and the
+    // checkpoints no longer needed to replay into what remains. Records are
+    // one per cycle, so the oldest one kept began at now - cycles.size().
+    void trim(int64_t now)
+    {
+        size_t drop = cycles.size() / 2;
+        if (drop == 0)
+            return;
+
+        const CycleRecord &first = cycles[drop];
+        size_t registerDrop = first.registerBegin;
+        size_t memoryDrop = first.memoryBegin;
+        size_t blockDrop = first.blockBegin;
+        size_t bytesDrop = first.bytesBegin;
+
+        cycles.erase(cycles.begin(), cycles.begin() + drop);
+        registerWrites.erase(registerWrites.begin(), registerWrites.begin() + registerDrop);
+        memoryWrites.erase(memoryWrites.begin(), memoryWrites.begin() + memoryDrop);
+        blockDeltas.erase(blockDeltas.begin(), blockDeltas.begin() + blockDrop);
+        blockBytes.erase(blockBytes.begin(), blockBytes.begin() + bytesDrop);
+
+        for (size_t i = 0; i < cycles.size(); i++)
+        {
+            cycles[i].registerBegin -= registerDrop;
+            cycles[i].memoryBegin -= memoryDrop;
+            cycles[i].blockBegin -= blockDrop;
+            cycles[i].bytesBegin -= bytesDrop;
+        }
+
+        int64_t oldest = now - (int64_t)cycles.size();
+        size_t checkpointDrop = 0;
+        while (checkpointDrop + 1 < checkpoints.size() && checkpoints[checkpointDrop + 1].scalars.totalCycles <= oldest)
+            checkpointDrop++;
+        checkpoints.erase(checkpoints.begin(), checkpoints.begin() + checkpointDrop);
+    }
+};
+
+#endif